@@ -0,0 +1,20 @@
+#ifndef _ASM_X86_QSPINLOCK_H
+#define _ASM_X86_QSPINLOCK_H
+
+#include <asm-generic/qspinlock_types.h>
+
+/*
+ * Stores are not reordered with older loads or stores on x86, so the
+ * owner can release the lock by clearing the locked byte with a plain
+ * store, leaving the pending and tail parts alone.
+ */
+#define queued_spin_unlock queued_spin_unlock
+static __always_inline void queued_spin_unlock(struct qspinlock *lock)
+{
+	barrier();
+	ACCESS_ONCE(*(u8 *)lock) = 0;
+}
+
+#include <asm-generic/qspinlock.h>
+
+#endif /* _ASM_X86_QSPINLOCK_H */
@@ -7,6 +7,10 @@
 
 #include <linux/types.h>
 
+#ifdef CONFIG_QUEUED_SPINLOCKS
+#include <asm-generic/qspinlock_types.h>
+#else
+
 #if (CONFIG_NR_CPUS < 256)
 typedef u8  __ticket_t;
 typedef u16 __ticketpair_t;
@@ -29,6 +33,8 @@ typedef struct arch_spinlock {
 
 #define __ARCH_SPIN_LOCK_UNLOCKED	{ { 0 } }
 
+#endif /* CONFIG_QUEUED_SPINLOCKS */
+
 #include <asm/rwlock.h>
 
 #endif /* _ASM_X86_SPINLOCK_TYPES_H */
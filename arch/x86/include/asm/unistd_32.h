@@ -354,10 +354,13 @@
 #define __NR_setns		346
 #define __NR_process_vm_readv	347
 #define __NR_process_vm_writev	348
+/* 349 and 350 are kcmp and finit_module upstream; not wired up here */
+#define __NR_sched_setattr	351
+#define __NR_sched_getattr	352
 
 #ifdef __KERNEL__
 
-#define NR_syscalls 349
+#define NR_syscalls 353
 
 #define __ARCH_WANT_IPC_PARSE_VERSION
 #define __ARCH_WANT_OLD_READDIR
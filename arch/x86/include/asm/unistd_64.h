@@ -686,6 +686,11 @@ __SYSCALL(__NR_getcpu, sys_getcpu)
 __SYSCALL(__NR_process_vm_readv, sys_process_vm_readv)
 #define __NR_process_vm_writev			311
 __SYSCALL(__NR_process_vm_writev, sys_process_vm_writev)
+/* 312 and 313 are kcmp and finit_module upstream; not wired up here */
+#define __NR_sched_setattr			314
+__SYSCALL(__NR_sched_setattr, sys_sched_setattr)
+#define __NR_sched_getattr			315
+__SYSCALL(__NR_sched_getattr, sys_sched_getattr)
 
 #ifndef __NO_STUBS
 #define __ARCH_WANT_OLD_READDIR
@@ -53,6 +53,28 @@ static void cpuidle_kick_cpus(void) {}
 
 static int __cpuidle_register_device(struct cpuidle_device *dev);
 
+/*
+ * An idle period is a hit for the state it was spent in if it lasted for
+ * at least the target residency of that state, but less than the one of
+ * the next deeper state; otherwise the state was too deep, or too shallow.
+ */
+static void cpuidle_account_hit(struct cpuidle_device *dev,
+				struct cpuidle_driver *drv, int index)
+{
+	struct cpuidle_state *state = &drv->states[index];
+	int residency = dev->last_residency;
+
+	if (!(state->flags & CPUIDLE_FLAG_TIME_VALID))
+		return;
+
+	if (residency < state->target_residency ||
+	    (index + 1 < drv->state_count &&
+	     residency >= drv->states[index + 1].target_residency))
+		dev->states_usage[index].miss++;
+	else
+		dev->states_usage[index].hit++;
+}
+
 /**
  * cpuidle_idle_call - the main idle loop
  *
@@ -110,6 +132,7 @@ int cpuidle_idle_call(void)
 		dev->states_usage[entered_state].time +=
 				(unsigned long long)dev->last_residency;
 		dev->states_usage[entered_state].usage++;
+		cpuidle_account_hit(dev, drv, entered_state);
 	}
 
 	/* give the governor an opportunity to reflect on the outcome */
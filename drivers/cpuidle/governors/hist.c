@@ -0,0 +1,306 @@
+/*
+ * hist.c - the wakeup histogram idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that accompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/module.h>
+
+/*
+ * Concepts and ideas behind the hist governor
+ *
+ * The menu governor starts from the time until the next timer event and
+ * scales it down by a correction factor. When the cpu is woken up by
+ * interrupts much more often than by timers, as on a server answering
+ * requests that arrive every few hundred microseconds, the next timer is
+ * far away, the correction factor only moves slowly, and deep states keep
+ * being picked, so that the exit latency is paid on every request.
+ *
+ * The hist governor does not predict a single duration. It keeps, per
+ * cpu, a histogram of the recent idle durations, and a histogram of the
+ * intervals between the wakeups that were not caused by the next timer,
+ * which are the interrupt interarrival times as seen from the idle loop.
+ * Both histograms have one bin per power of two microseconds, and older
+ * samples decay away as new ones are added.
+ *
+ * A state is a candidate if, according to both histograms, the cpu is
+ * going to stay idle for at least its target residency with a probability
+ * of at least hit_pct percent; for the interrupt histogram, this takes the
+ * time elapsed since the last interrupt wakeup into account. The deepest
+ * candidate whose exit latency satisfies the PM QoS constraint, and whose
+ * target residency is not beyond the next timer event, is selected.
+ *
+ * How well this works can be seen from the per-state "hit" and "miss"
+ * counters in sysfs, which the cpuidle core maintains for any governor.
+ */
+
+#define NR_BINS		24	/* the last bin is for 4s and above */
+#define DECAY_SHIFT	4	/* about the last 16 samples count */
+#define SAMPLE_WEIGHT	1024
+
+static unsigned int hit_pct = 75;
+
+/* Above 100 no state would ever fit, and at 0 every state would */
+static int hist_set_hit_pct(const char *val, const struct kernel_param *kp)
+{
+	unsigned int pct;
+	int ret;
+
+	ret = kstrtouint(val, 0, &pct);
+	if (ret)
+		return ret;
+
+	*(unsigned int *)kp->arg = clamp_val(pct, 1, 100);
+	return 0;
+}
+
+static const struct kernel_param_ops hit_pct_param_ops = {
+	.set	= hist_set_hit_pct,
+	.get	= param_get_uint,
+};
+
+module_param_cb(hit_pct, &hit_pct_param_ops, &hit_pct, 0644);
+MODULE_PARM_DESC(hit_pct,
+		 "Probability, in percent, that the target residency of a state is reached for it to be selected");
+
+struct hist_device {
+	int		last_state_idx;
+	int		needs_update;
+
+	unsigned int	sleep_us;	/* until the next timer event */
+	ktime_t		entry;		/* when idle was entered */
+	ktime_t		last_irq;	/* last wakeup not caused by a timer */
+
+	u32		idle_bins[NR_BINS];
+	u32		irq_bins[NR_BINS];
+};
+
+static DEFINE_PER_CPU(struct hist_device, hist_devices);
+
+static void hist_update(struct cpuidle_driver *drv, struct cpuidle_device *dev);
+
+/* Bin 0 is for 0, bin n covers [2^(n-1), 2^n) microseconds */
+static inline unsigned int bin_of(unsigned int us)
+{
+	return min_t(unsigned int, fls(us), NR_BINS - 1);
+}
+
+static void add_sample(u32 *bins, unsigned int us)
+{
+	int i;
+
+	for (i = 0; i < NR_BINS; i++)
+		bins[i] -= bins[i] >> DECAY_SHIFT;
+	bins[bin_of(us)] += SAMPLE_WEIGHT;
+}
+
+/*
+ * Weight of the samples of at least @us microseconds. Samples are
+ * assumed to be evenly spread within their bin.
+ */
+static u64 survival(const u32 *bins, unsigned int us)
+{
+	unsigned int b = bin_of(us), lo;
+	u64 sum = 0;
+	int i;
+
+	for (i = b + 1; i < NR_BINS; i++)
+		sum += bins[i];
+
+	if (b == 0 || b == NR_BINS - 1)
+		return sum + bins[b];
+
+	lo = 1U << (b - 1);
+	return sum + div_u64((u64)bins[b] * (2 * lo - us), lo);
+}
+
+/*
+ * Is the cpu going to stay idle for @residency microseconds with the
+ * required probability, @elapsed microseconds after the last interrupt
+ * wakeup?
+ */
+static bool residency_fits(struct hist_device *data, unsigned int residency,
+			   unsigned int elapsed)
+{
+	u64 total, left;
+
+	total = survival(data->idle_bins, 0);
+	left = survival(data->idle_bins, residency);
+	if (total && left * 100 < total * hit_pct)
+		return false;
+
+	/* Interrupts expected to have come already tell nothing */
+	total = survival(data->irq_bins, elapsed);
+	if (!total)
+		return true;
+	left = survival(data->irq_bins, min(elapsed, UINT_MAX - residency) +
+				       residency);
+	return left * 100 >= total * hit_pct;
+}
+
+static unsigned int to_us(ktime_t t)
+{
+	s64 us = ktime_to_us(t);
+
+	return clamp_t(s64, us, 0, UINT_MAX);
+}
+
+/**
+ * hist_select - selects the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static int hist_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct hist_device *data = &__get_cpu_var(hist_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int elapsed;
+	int i;
+
+	if (data->needs_update) {
+		hist_update(drv, dev);
+		data->needs_update = 0;
+	}
+
+	data->last_state_idx = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	data->sleep_us = to_us(tick_nohz_get_sleep_length());
+	data->entry = ktime_get();
+	elapsed = to_us(ktime_sub(data->entry, data->last_irq));
+
+	/*
+	 * We want to default to C1 (hlt), not to busy polling
+	 * unless the timer is happening really really soon.
+	 */
+	if (data->sleep_us > 5)
+		data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+
+		if (s->target_residency > data->sleep_us)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+		if (!residency_fits(data, s->target_residency, elapsed))
+			continue;
+
+		data->last_state_idx = i;
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * hist_reflect - records that data structures need update
+ * @dev: the CPU
+ * @index: the index of actual entered state
+ *
+ * NOTE: it's important to be fast here because this operation will add to
+ *       the overall exit latency.
+ */
+static void hist_reflect(struct cpuidle_device *dev, int index)
+{
+	struct hist_device *data = &__get_cpu_var(hist_devices);
+
+	data->last_state_idx = index;
+	if (index >= 0)
+		data->needs_update = 1;
+}
+
+/**
+ * hist_update - adds the last idle period to the histograms
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static void hist_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
+{
+	struct hist_device *data = &__get_cpu_var(hist_devices);
+	struct cpuidle_state *target = &drv->states[data->last_state_idx];
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+	ktime_t wakeup;
+
+	/*
+	 * This idle state doesn't support residency measurements: assume
+	 * we slept until the next timer, and learn nothing about
+	 * interrupts.
+	 */
+	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID))) {
+		add_sample(data->idle_bins, data->sleep_us);
+		return;
+	}
+
+	add_sample(data->idle_bins, measured_us);
+
+	/*
+	 * Woken up well before the next timer: this was an interrupt.
+	 * The first one only starts the interval.
+	 */
+	if ((u64)measured_us * 8 >= (u64)data->sleep_us * 7)
+		return;
+
+	wakeup = ktime_add_us(data->entry, measured_us);
+	if (data->last_irq.tv64)
+		add_sample(data->irq_bins,
+			   to_us(ktime_sub(wakeup, data->last_irq)));
+	data->last_irq = wakeup;
+}
+
+/**
+ * hist_enable_device - scans a CPU's states and does setup
+ * @drv: cpuidle driver
+ * @dev: the CPU
+ */
+static int hist_enable_device(struct cpuidle_driver *drv,
+				struct cpuidle_device *dev)
+{
+	struct hist_device *data = &per_cpu(hist_devices, dev->cpu);
+
+	memset(data, 0, sizeof(struct hist_device));
+
+	return 0;
+}
+
+static struct cpuidle_governor hist_governor = {
+	.name =		"hist",
+	.rating =	15,
+	.enable =	hist_enable_device,
+	.select =	hist_select,
+	.reflect =	hist_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_hist - initializes the governor
+ */
+static int __init init_hist(void)
+{
+	return cpuidle_register_governor(&hist_governor);
+}
+
+/**
+ * exit_hist - exits the governor
+ */
+static void __exit exit_hist(void)
+{
+	cpuidle_unregister_governor(&hist_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_hist);
+module_exit(exit_hist);
@@ -251,6 +251,8 @@ define_show_state_function(exit_latency)
 define_show_state_function(power_usage)
 define_show_state_ull_function(usage)
 define_show_state_ull_function(time)
+define_show_state_ull_function(hit)
+define_show_state_ull_function(miss)
 define_show_state_str_function(name)
 define_show_state_str_function(desc)
 
@@ -260,6 +262,8 @@ define_one_state_ro(latency, show_state_exit_latency);
 define_one_state_ro(power, show_state_power_usage);
 define_one_state_ro(usage, show_state_usage);
 define_one_state_ro(time, show_state_time);
+define_one_state_ro(hit, show_state_hit);
+define_one_state_ro(miss, show_state_miss);
 
 static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_name.attr,
@@ -268,6 +272,8 @@ static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_power.attr,
 	&attr_usage.attr,
 	&attr_time.attr,
+	&attr_hit.attr,
+	&attr_miss.attr,
 	NULL
 };
 
@@ -0,0 +1,83 @@
+/*
+ * Compression backends and stream management for zram
+ *
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZCOMP_H_
+#define _ZCOMP_H_
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/wait.h>
+
+/*
+ * A compression stream: the per-request scratch state of a compressor.
+ * Only compression needs one; decompression runs without a stream so
+ * that reads never wait behind writes.
+ */
+struct zcomp_strm {
+	/* compression/decompression buffer, 2 pages */
+	void *buffer;
+	/* compressor private data (working memory) */
+	void *private;
+	/* used in the idle stream list */
+	struct list_head list;
+};
+
+/* static compression backend */
+struct zcomp_backend {
+	int (*compress)(const unsigned char *src, unsigned char *dst,
+			size_t *dst_len, void *private);
+
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst);
+
+	void *(*create)(void);
+	void (*destroy)(void *private);
+
+	const char *name;
+};
+
+/*
+ * Pool of compression streams. Streams are created on demand up to
+ * max_strm; once that many are in use further writers sleep until one
+ * is released.
+ */
+struct zcomp {
+	spinlock_t strm_lock;		/* protects the fields below */
+	struct list_head idle_strm;	/* streams ready for use */
+	wait_queue_head_t strm_wait;	/* writers waiting for a stream */
+	int avail_strm;			/* streams allocated */
+	int max_strm;			/* upper limit of avail_strm */
+	u64 nr_waits;			/* times a writer had to wait */
+
+	struct zcomp_backend *backend;
+};
+
+ssize_t zcomp_available_show(const char *comp, char *buf);
+bool zcomp_available_algorithm(const char *comp);
+
+struct zcomp *zcomp_create(const char *comp, int max_strm);
+void zcomp_destroy(struct zcomp *comp);
+
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp);
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm);
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len);
+
+int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
+		size_t src_len, unsigned char *dst);
+
+bool zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+u64 zcomp_nr_waits(struct zcomp *comp);
+
+#endif /* _ZCOMP_H_ */
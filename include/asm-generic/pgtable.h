@@ -530,6 +530,17 @@ static inline int pmd_trans_unstable(pmd_t *pmd)
 #endif
 }
 
+#ifndef CONFIG_NUMA_BALANCING
+/*
+ * Only architectures that support NUMA balancing need to tell NUMA
+ * hinting ptes apart from other present ptes.
+ */
+static inline int pte_protnone(pte_t pte)
+{
+	return 0;
+}
+#endif
+
 #endif /* CONFIG_MMU */
 
 #endif /* !__ASSEMBLY__ */
@@ -691,9 +691,16 @@ __SC_COMP(__NR_process_vm_readv, sys_process_vm_readv, \
 #define __NR_process_vm_writev 271
 __SC_COMP(__NR_process_vm_writev, sys_process_vm_writev, \
           compat_sys_process_vm_writev)
+/* 272 and 273 are kcmp and finit_module upstream */
+__SYSCALL(272, sys_ni_syscall)
+__SYSCALL(273, sys_ni_syscall)
+#define __NR_sched_setattr 274
+__SYSCALL(__NR_sched_setattr, sys_sched_setattr)
+#define __NR_sched_getattr 275
+__SYSCALL(__NR_sched_getattr, sys_sched_getattr)
 
 #undef __NR_syscalls
-#define __NR_syscalls 272
+#define __NR_syscalls 276
 
 /*
  * All syscalls below here should go away really,
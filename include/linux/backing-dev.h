@@ -42,6 +42,8 @@ enum bdi_stat_item {
 	BDI_WRITEBACK,
 	BDI_DIRTIED,
 	BDI_WRITTEN,
+	BDI_RA_HIT,
+	BDI_RA_WASTE,
 	NR_BDI_STAT_ITEMS
 };
 
@@ -35,6 +35,8 @@ struct cpuidle_state_usage {
 
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	hit;  /* residency matched the state */
+	unsigned long long	miss; /* state was too deep or too shallow */
 };
 
 struct cpuidle_state {
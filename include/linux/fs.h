@@ -939,6 +939,16 @@ struct fown_struct {
 	int signum;		/* posix.1b rt signal to be delivered on IO */
 };
 
+/*
+ * Access patterns recognised by the readahead code, see mm/readahead.c
+ */
+#define RA_PATTERN_SEQUENTIAL	0
+#define RA_PATTERN_STRIDE	1	/* fixed distance, forward or backward */
+#define RA_PATTERN_CLUSTER	2	/* misses bunched in a small region */
+#define RA_PATTERN_RANDOM	3	/* readahead did not pay off */
+
+#define RA_MISS_HISTORY		4
+
 /*
  * Track a single file's readahead state
  */
@@ -951,6 +961,16 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	unsigned int pattern;		/* Detected access pattern */
+	long stride;			/* Pages between strided accesses */
+	unsigned int nr_miss;		/* Valid entries in miss[] */
+	pgoff_t miss[RA_MISS_HISTORY];	/* Recent cache misses, newest first */
+
+	pgoff_t acct_start[2];		/* The last two readahead windows, */
+	unsigned int acct_size[2];	/*   newest first, not yet checked */
+	unsigned int hit;		/* Decaying count of used and */
+	unsigned int total;		/*   of all readahead pages */
 };
 
 /*
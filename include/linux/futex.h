@@ -124,6 +124,8 @@ struct robust_list_head {
 #define FUTEX_BITSET_MATCH_ANY	0xffffffff
 
 #ifdef __KERNEL__
+#include <linux/errno.h>
+
 struct inode;
 struct mm_struct;
 struct task_struct;
@@ -185,6 +187,24 @@ static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
 #endif
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+extern int futex_hash_allocate(unsigned long buckets);
+extern int futex_hash_buckets(void);
+extern void futex_hash_free(struct mm_struct *mm);
+#else
+static inline int futex_hash_allocate(unsigned long buckets)
+{
+	return -EINVAL;
+}
+static inline int futex_hash_buckets(void)
+{
+	return 0;
+}
+static inline void futex_hash_free(struct mm_struct *mm)
+{
+}
+#endif
 #endif /* __KERNEL__ */
 
 #define FUTEX_OP_SET		0	/* *(int *)UADDR2 = OPARG; */
@@ -21,6 +21,7 @@
 #define AT_VECTOR_SIZE (2*(AT_VECTOR_SIZE_ARCH + AT_VECTOR_SIZE_BASE + 1))
 
 struct address_space;
+struct futex_private_hash;
 
 #define USE_SPLIT_PTLOCKS	(NR_CPUS >= CONFIG_SPLIT_PTLOCK_CPUS)
 
@@ -363,6 +364,10 @@ struct mm_struct {
 	spinlock_t		ioctx_lock;
 	struct hlist_head	ioctx_list;
 #endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	/* hash of the private futexes, if not the global one */
+	struct futex_private_hash *futex_hash;
+#endif
 #ifdef CONFIG_MM_OWNER
 	/*
 	 * "owner" points to a task that is regarded as the canonical
@@ -386,6 +391,27 @@ struct mm_struct {
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	pgtable_t pmd_huge_pte; /* protected by page_table_lock */
 #endif
+#ifdef CONFIG_NUMA_BALANCING
+	/*
+	 * numa_next_scan is the next time that the PTEs will be marked
+	 * for NUMA hinting faults; the thread that moves it forward does
+	 * the scan. numa_scan_offset is where that scan resumes and
+	 * numa_scan_seq counts completed passes over the address space.
+	 */
+	unsigned long numa_next_scan;
+	unsigned long numa_scan_offset;
+	int numa_scan_seq;
+#endif
+#ifdef CONFIG_KSM
+	/*
+	 * Updated by ksmd only: rmap_items tracking pages of this mm, how
+	 * many of those pages are currently merged, and how many pages of
+	 * this mm ksmd has scanned so far.
+	 */
+	unsigned long ksm_rmap_items;
+	unsigned long ksm_merging_pages;
+	unsigned long ksm_pages_scanned;
+#endif
 #ifdef CONFIG_CPUMASK_OFFSTACK
 	struct cpumask cpumask_allocation;
 #endif
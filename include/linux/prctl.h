@@ -102,4 +102,13 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Set/get the number of buckets of the private futex hash of the process.
+ * Setting it only works once, while the process is single threaded.
+ * The values ("FUT" in the top bytes) stay clear of the numbers handed
+ * out in sequence above.
+ */
+#define PR_SET_FUTEX_HASH 0x46555401
+#define PR_GET_FUTEX_HASH 0x46555402
+
 #endif /* _LINUX_PRCTL_H */
@@ -204,6 +204,15 @@ typedef void call_rcu_func_t(struct rcu_head *head,
 			     void (*func)(struct rcu_head *head));
 void wait_rcu_gp(call_rcu_func_t crf);
 
+#ifdef CONFIG_RCU_NOCB_CPU
+extern bool rcu_is_nocb_cpu(int cpu);
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+static inline bool rcu_is_nocb_cpu(int cpu)
+{
+	return false;
+}
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
+
 #if defined(CONFIG_TREE_RCU) || defined(CONFIG_TREE_PREEMPT_RCU)
 #include <linux/rcutree.h>
 #elif defined(CONFIG_TINY_RCU) || defined(CONFIG_TINY_PREEMPT_RCU)
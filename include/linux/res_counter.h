@@ -14,6 +14,7 @@
  */
 
 #include <linux/cgroup.h>
+#include <linux/atomic.h>
 
 /*
  * The core object. the cgroup that wishes to account for some
@@ -23,9 +24,10 @@
 
 struct res_counter {
 	/*
-	 * the current resource consumption level
+	 * the current resource consumption level, charged and uncharged
+	 * with atomic operations only
 	 */
-	unsigned long long usage;
+	atomic64_t usage;
 	/*
 	 * the maximal value of the usage from the counter creation
 	 */
@@ -43,7 +45,9 @@ struct res_counter {
 	 */
 	unsigned long long failcnt;
 	/*
-	 * the lock to protect all of the above.
+	 * the lock to serialize updates of the limits and resets of the
+	 * statistics. charging does not take it: it updates max_usage and
+	 * failcnt racily, they are statistics only.
 	 * the routines below consider this to be IRQ-safe
 	 */
 	spinlock_t lock;
@@ -108,11 +112,9 @@ void res_counter_init(struct res_counter *counter, struct res_counter *parent);
  *       units, e.g. numbers, bytes, Kbytes, etc
  *
  * returns 0 on success and <0 if the counter->usage will exceed the
- * counter->limit _locked call expects the counter->lock to be taken
+ * counter->limit of the counter or of one of its parents
  */
 
-int __must_check res_counter_charge_locked(struct res_counter *counter,
-		unsigned long val);
 int __must_check res_counter_charge(struct res_counter *counter,
 		unsigned long val, struct res_counter **limit_fail_at);
 
@@ -122,11 +124,9 @@ int __must_check res_counter_charge(struct res_counter *counter,
  * @counter: the counter
  * @val: the amount of the resource
  *
- * these calls check for usage underflow and show a warning on the console
- * _locked call expects the counter->lock to be taken
+ * this call checks for usage underflow and shows a warning on the console
  */
 
-void res_counter_uncharge_locked(struct res_counter *counter, unsigned long val);
 void res_counter_uncharge(struct res_counter *counter, unsigned long val);
 
 /**
@@ -138,13 +138,11 @@ void res_counter_uncharge(struct res_counter *counter, unsigned long val);
  */
 static inline unsigned long long res_counter_margin(struct res_counter *cnt)
 {
-	unsigned long long margin;
-	unsigned long flags;
+	unsigned long long usage = atomic64_read(&cnt->usage);
+	unsigned long long limit = ACCESS_ONCE(cnt->limit);
 
-	spin_lock_irqsave(&cnt->lock, flags);
-	margin = cnt->limit - cnt->usage;
-	spin_unlock_irqrestore(&cnt->lock, flags);
-	return margin;
+	/* a racing charge may be over the limit until it backs out */
+	return usage < limit ? limit - usage : 0;
 }
 
 /**
@@ -157,16 +155,12 @@ static inline unsigned long long res_counter_margin(struct res_counter *cnt)
 static inline unsigned long long
 res_counter_soft_limit_excess(struct res_counter *cnt)
 {
-	unsigned long long excess;
-	unsigned long flags;
+	unsigned long long usage = atomic64_read(&cnt->usage);
+	unsigned long long soft_limit = ACCESS_ONCE(cnt->soft_limit);
 
-	spin_lock_irqsave(&cnt->lock, flags);
-	if (cnt->usage <= cnt->soft_limit)
-		excess = 0;
-	else
-		excess = cnt->usage - cnt->soft_limit;
-	spin_unlock_irqrestore(&cnt->lock, flags);
-	return excess;
+	if (usage <= soft_limit)
+		return 0;
+	return usage - soft_limit;
 }
 
 static inline void res_counter_reset_max(struct res_counter *cnt)
@@ -174,7 +168,7 @@ static inline void res_counter_reset_max(struct res_counter *cnt)
 	unsigned long flags;
 
 	spin_lock_irqsave(&cnt->lock, flags);
-	cnt->max_usage = cnt->usage;
+	cnt->max_usage = atomic64_read(&cnt->usage);
 	spin_unlock_irqrestore(&cnt->lock, flags);
 }
 
@@ -190,13 +184,24 @@ static inline void res_counter_reset_failcnt(struct res_counter *cnt)
 static inline int res_counter_set_limit(struct res_counter *cnt,
 		unsigned long long limit)
 {
+	unsigned long long old;
 	unsigned long flags;
 	int ret = -EBUSY;
 
 	spin_lock_irqsave(&cnt->lock, flags);
-	if (cnt->usage <= limit) {
+	old = cnt->limit;
+	if (atomic64_read(&cnt->usage) <= limit) {
 		cnt->limit = limit;
-		ret = 0;
+		/*
+		 * Pairs with the atomic update in res_counter_charge():
+		 * either a racing charge sees the new limit or we see
+		 * its usage and back out.
+		 */
+		smp_mb();
+		if (atomic64_read(&cnt->usage) <= limit)
+			ret = 0;
+		else
+			cnt->limit = old;
 	}
 	spin_unlock_irqrestore(&cnt->lock, flags);
 	return ret;
@@ -32,8 +32,24 @@ struct shmem_sb_info {
 	gid_t gid;		    /* Mount gid for root directory */
 	mode_t mode;		    /* Mount mode for root directory */
 	struct mempolicy *mpol;     /* default memory policy for mappings */
+	int huge;		    /* Whether to allocate huge extents */
 };
 
+/*
+ * Huge extent policies: the huge= mount option of a tmpfs instance, and
+ * transparent_hugepage/shmem_enabled for the internal mount used by SysV
+ * shared memory and shared anonymous mappings.
+ *
+ * A huge extent is only allocated as one huge page: it is split at once
+ * and never mapped by a huge pmd.  There is no "always" policy, because
+ * without the pmd mapping it would only cost memory on sparse files.
+ */
+#define SHMEM_HUGE_NEVER	0
+#define SHMEM_HUGE_WITHIN_SIZE	1
+#define SHMEM_HUGE_ADVISE	2
+/* Only allowed in shmem_enabled, where it overrides every mount */
+#define SHMEM_HUGE_DENY		(-1)
+
 static inline struct shmem_inode_info *SHMEM_I(struct inode *inode)
 {
 	return container_of(inode, struct shmem_inode_info, vfs_inode);
@@ -54,6 +70,12 @@ extern struct page *shmem_read_mapping_page_gfp(struct address_space *mapping,
 extern void shmem_truncate_range(struct inode *inode, loff_t start, loff_t end);
 extern int shmem_unuse(swp_entry_t entry, struct page *page);
 
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+extern int shmem_huge;
+extern int shmem_parse_huge(const char *str);
+extern const char *shmem_format_huge(int huge);
+#endif
+
 static inline struct page *shmem_read_mapping_page(
 				struct address_space *mapping, pgoff_t index)
 {
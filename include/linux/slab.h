@@ -104,6 +104,14 @@ struct kmem_cache *kmem_cache_create(const char *, size_t, size_t,
 void kmem_cache_destroy(struct kmem_cache *);
 int kmem_cache_shrink(struct kmem_cache *);
 void kmem_cache_free(struct kmem_cache *, void *);
+
+/*
+ * Bulk allocation and freeing of objects. kmem_cache_alloc_bulk() either
+ * fills all @size slots of the array and returns @size, or returns 0.
+ * kmem_cache_free_bulk() ignores NULL entries.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *, gfp_t, size_t, void **);
+void kmem_cache_free_bulk(struct kmem_cache *, size_t, void **);
 unsigned int kmem_cache_size(struct kmem_cache *);
 
 /*
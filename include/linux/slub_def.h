@@ -38,14 +38,24 @@ enum stat_item {
 	CMPXCHG_DOUBLE_FAIL,	/* Number of times that cmpxchg double did not match */
 	CPU_PARTIAL_ALLOC,	/* Used cpu partial on alloc */
 	CPU_PARTIAL_FREE,	/* USed cpu partial on free */
+	FREE_REMOTE_BATCH,	/* Remote free parked in the cpu magazine */
+	REMOTE_BATCH_FLUSH,	/* Cpu magazine flushed to the slabs */
 	NR_SLUB_STAT_ITEMS };
 
+/*
+ * Maximum number of remotely freed objects a cpu collects before they are
+ * returned to their slabs in one go.
+ */
+#define SLUB_REMOTE_BATCH	16
+
 struct kmem_cache_cpu {
 	void **freelist;	/* Pointer to next available object */
 	unsigned long tid;	/* Globally unique transaction id */
 	struct page *page;	/* The slab from which we are allocating */
 	struct page *partial;	/* Partially allocated frozen slabs */
 	int node;		/* The node of the page (or -1 for debug) */
+	int nr_remote;		/* Number of objects in remote[] */
+	void *remote[SLUB_REMOTE_BATCH];	/* Frees to other slabs */
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
@@ -83,6 +93,7 @@ struct kmem_cache {
 	int objsize;		/* The size of an object without meta data */
 	int offset;		/* Free pointer offset. */
 	int cpu_partial;	/* Number of per cpu partial objects to keep around */
+	int remote_batch;	/* Remote frees batched per cpu, 0 = off */
 	struct kmem_cache_order_objects oo;
 
 	/* Allocation and freeing of slabs */
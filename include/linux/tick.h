@@ -45,6 +45,11 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @full_stopped:	Indicator that the tick has been stopped while running
+ *			a task (full dynticks)
+ * @full_user:		The task was in user mode when the tick was stopped
+ * @full_jiffies:	jiffies when the tick was stopped, for the cputime
+ *			accounting of the task
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -67,6 +72,11 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+#ifdef CONFIG_NO_HZ_FULL
+	int				full_stopped;
+	int				full_user;
+	unsigned long			full_jiffies;
+#endif
 };
 
 extern void __init tick_init(void);
@@ -139,4 +149,52 @@ static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 static inline u64 get_cpu_iowait_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+# ifdef CONFIG_NO_HZ_FULL
+extern bool tick_nohz_full_running;
+extern cpumask_var_t tick_nohz_full_mask;
+
+static inline bool tick_nohz_full_cpu(int cpu)
+{
+	if (!tick_nohz_full_running)
+		return false;
+
+	return cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+extern void __tick_nohz_full_irq_exit(void);
+extern void __tick_nohz_full_schedule(void);
+extern void __tick_nohz_full_kick_cpu(int cpu);
+extern bool tick_nohz_full_tick_stopped(int cpu);
+extern void tick_nohz_full_kick_all(void);
+
+static inline void tick_nohz_full_irq_exit(void)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_full_irq_exit();
+}
+
+/*
+ * Called on entry to schedule(): the current task is likely to block or
+ * be preempted, so the tick has to run again for whatever comes next.
+ */
+static inline void tick_nohz_full_schedule(void)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_full_schedule();
+}
+
+static inline void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (tick_nohz_full_cpu(cpu))
+		__tick_nohz_full_kick_cpu(cpu);
+}
+# else
+static inline bool tick_nohz_full_cpu(int cpu) { return false; }
+static inline void tick_nohz_full_irq_exit(void) { }
+static inline void tick_nohz_full_schedule(void) { }
+static inline bool tick_nohz_full_tick_stopped(int cpu) { return false; }
+static inline void tick_nohz_full_kick_cpu(int cpu) { }
+static inline void tick_nohz_full_kick_all(void) { }
+# endif /* !NO_HZ_FULL */
+
 #endif
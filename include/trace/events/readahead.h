@@ -0,0 +1,101 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM readahead
+
+#if !defined(_TRACE_READAHEAD_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_READAHEAD_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/kdev_t.h>
+#include <linux/tracepoint.h>
+
+#define show_ra_pattern(pattern)				\
+	__print_symbolic(pattern,				\
+		{ RA_PATTERN_SEQUENTIAL,	"sequential" },	\
+		{ RA_PATTERN_STRIDE,		"stride" },	\
+		{ RA_PATTERN_CLUSTER,		"cluster" },	\
+		{ RA_PATTERN_RANDOM,		"random" })
+
+TRACE_EVENT(readahead,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t offset,
+		unsigned long req_size, unsigned int pattern,
+		pgoff_t start, unsigned long size, unsigned long actual),
+
+	TP_ARGS(mapping, offset, req_size, pattern, start, size, actual),
+
+	TP_STRUCT__entry(
+		__field(dev_t, dev)
+		__field(unsigned long, ino)
+		__field(pgoff_t, offset)
+		__field(unsigned long, req_size)
+		__field(unsigned int, pattern)
+		__field(pgoff_t, start)
+		__field(unsigned long, size)
+		__field(unsigned long, actual)
+	),
+
+	TP_fast_assign(
+		__entry->dev = mapping->host->i_sb->s_dev;
+		__entry->ino = mapping->host->i_ino;
+		__entry->offset = offset;
+		__entry->req_size = req_size;
+		__entry->pattern = pattern;
+		__entry->start = start;
+		__entry->size = size;
+		__entry->actual = actual;
+	),
+
+	TP_printk("dev=%d:%d ino=%lx offset=%lu req_size=%lu pattern=%s "
+		  "start=%lu size=%lu actual=%lu",
+		MAJOR(__entry->dev), MINOR(__entry->dev),
+		__entry->ino,
+		__entry->offset,
+		__entry->req_size,
+		show_ra_pattern(__entry->pattern),
+		__entry->start,
+		__entry->size,
+		__entry->actual)
+);
+
+TRACE_EVENT(readahead_account,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t start,
+		unsigned long size, unsigned long hit,
+		unsigned int hit_ratio),
+
+	TP_ARGS(mapping, start, size, hit, hit_ratio),
+
+	TP_STRUCT__entry(
+		__field(dev_t, dev)
+		__field(unsigned long, ino)
+		__field(pgoff_t, start)
+		__field(unsigned long, size)
+		__field(unsigned long, hit)
+		__field(unsigned int, hit_ratio)
+	),
+
+	TP_fast_assign(
+		__entry->dev = mapping->host->i_sb->s_dev;
+		__entry->ino = mapping->host->i_ino;
+		__entry->start = start;
+		__entry->size = size;
+		__entry->hit = hit;
+		__entry->hit_ratio = hit_ratio;
+	),
+
+	TP_printk("dev=%d:%d ino=%lx start=%lu size=%lu hit=%lu waste=%lu "
+		  "hit_ratio=%u%%",
+		MAJOR(__entry->dev), MINOR(__entry->dev),
+		__entry->ino,
+		__entry->start,
+		__entry->size,
+		__entry->hit,
+		__entry->size - __entry->hit,
+		__entry->hit_ratio)
+);
+
+#endif /* _TRACE_READAHEAD_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -36,6 +36,7 @@
 #include <linux/perf_event.h>
 #include <linux/ftrace_event.h>
 #include <linux/hw_breakpoint.h>
+#include <linux/tick.h>
 
 #include "internal.h"
 
@@ -637,8 +638,11 @@ static void perf_pmu_rotate_start(struct pmu *pmu)
 
 	WARN_ON(!irqs_disabled());
 
-	if (list_empty(&cpuctx->rotation_list))
+	if (list_empty(&cpuctx->rotation_list)) {
 		list_add(&cpuctx->rotation_list, head);
+		/* Rotation is done from the tick */
+		tick_nohz_full_kick_cpu(smp_processor_id());
+	}
 }
 
 static void get_ctx(struct perf_event_context *ctx)
@@ -2457,6 +2461,11 @@ void perf_event_task_tick(void)
 	}
 }
 
+bool perf_event_can_stop_tick(void)
+{
+	return list_empty(&__get_cpu_var(rotation_list));
+}
+
 static int event_enable_on_exec(struct perf_event *event,
 				struct perf_event_context *ctx)
 {
@@ -61,6 +61,9 @@
 #include <linux/nsproxy.h>
 #include <linux/ptrace.h>
 #include <linux/hugetlb.h>
+#include <linux/bootmem.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -68,8 +71,6 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
-
 /*
  * Futex flags used to encode options to functions and preserve them across
  * restarts.
@@ -147,19 +148,63 @@ static const struct futex_q futex_q_init = {
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
+} ____cacheline_aligned_in_smp;
+
+/*
+ * The global hash is sized at boot after the number of possible cpus,
+ * see futex_init().
+ */
+static unsigned long __read_mostly futex_hashsize;
+static struct futex_hash_bucket *futex_queues __read_mostly;
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/*
+ * A process can ask for a hash of its own for its private futexes, so
+ * that they do not collide with the futexes of other processes.
+ */
+struct futex_private_hash {
+	unsigned long hashsize;
+	struct futex_hash_bucket queues[0];
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+static inline struct futex_hash_bucket *
+private_hash_futex(union futex_key *key, u32 hash)
+{
+	struct futex_private_hash *fph;
+
+	/* Private futexes are the ones without a reference on inode or mm */
+	if (key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))
+		return NULL;
+
+	fph = ACCESS_ONCE(key->private.mm->futex_hash);
+	if (!fph)
+		return NULL;
+
+	return &fph->queues[hash & (fph->hashsize - 1)];
+}
+#else
+static inline struct futex_hash_bucket *
+private_hash_futex(union futex_key *key, u32 hash)
+{
+	return NULL;
+}
+#endif
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
+	struct futex_hash_bucket *hb;
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+
+	hb = private_hash_futex(key, hash);
+	if (hb)
+		return hb;
+
+	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
 /*
@@ -2740,10 +2785,90 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	return do_futex(uaddr, op, val, tp, uaddr2, val2, val3);
 }
 
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/**
+ * futex_hash_allocate() - give the current process a private futex hash
+ * @buckets:	number of hash buckets, rounded up to a power of two
+ *
+ * This can only be done once, and while the process is single threaded:
+ * there is then nobody else who could be queued on one of its private
+ * futexes, so there is nothing to move over to the new hash.
+ *
+ * Return: 0 on success, -EINVAL if @buckets is 0, -EBUSY if the process
+ * already has a private hash or more than one thread, -ENOMEM.
+ */
+int futex_hash_allocate(unsigned long buckets)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph;
+	size_t size;
+	unsigned long i;
+
+	if (!buckets)
+		return -EINVAL;
+	if (!mm || atomic_read(&mm->mm_users) != 1 || mm->futex_hash)
+		return -EBUSY;
+
+	/* More buckets than the global hash would be of no use */
+	buckets = roundup_pow_of_two(min(buckets, futex_hashsize));
+
+	size = sizeof(*fph) + buckets * sizeof(struct futex_hash_bucket);
+	if (size > PAGE_SIZE)
+		fph = vzalloc(size);
+	else
+		fph = kzalloc(size, GFP_KERNEL);
+	if (!fph)
+		return -ENOMEM;
+
+	fph->hashsize = buckets;
+	for (i = 0; i < buckets; i++) {
+		plist_head_init(&fph->queues[i].chain);
+		spin_lock_init(&fph->queues[i].lock);
+	}
+	mm->futex_hash = fph;
+
+	return 0;
+}
+
+/**
+ * futex_hash_buckets() - size of the private futex hash of the process
+ *
+ * Return: the number of buckets, or 0 if the process uses the global hash.
+ */
+int futex_hash_buckets(void)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (!mm || !mm->futex_hash)
+		return 0;
+
+	return mm->futex_hash->hashsize;
+}
+
+/*
+ * Called when the mm goes away: there are no more tasks, hence no more
+ * waiters on its private futexes.
+ */
+void futex_hash_free(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph = mm->futex_hash;
+
+	if (!fph)
+		return;
+
+	mm->futex_hash = NULL;
+	if (is_vmalloc_addr(fph))
+		vfree(fph);
+	else
+		kfree(fph);
+}
+#endif /* CONFIG_FUTEX_PRIVATE_HASH */
+
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
+	unsigned long i;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2758,7 +2883,23 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+	/*
+	 * Unrelated futexes share the buckets, and their lock: scale the
+	 * hash with the number of cpus that can contend on it.
+	 */
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0, 0,
+					       &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
+
+	for (i = 0; i < futex_hashsize; i++) {
 		plist_head_init(&futex_queues[i].chain);
 		spin_lock_init(&futex_queues[i].lock);
 	}
@@ -0,0 +1,294 @@
+/*
+ * Spinlock module-based torture test facility
+ *
+ * Starts nthreads kernel threads, each bound to its own CPU, which keep
+ * taking and releasing one spinlock until the module is removed.  The
+ * CPUs are taken node after node, or with spread=1 one from each NUMA
+ * node in turn, so that the same number of threads can be compared
+ * while packed onto as few nodes as possible and spread over the
+ * largest node distance.
+ *
+ * Every stat_interval seconds, and once more at rmmod, the acquisitions
+ * per second since the previous report are printed, along with those of
+ * the slowest and the fastest thread, which shows how fair the lock is.
+ *
+ * Each critical section also increments a counter protected by the lock.
+ * At rmmod it must match the sum of the acquisitions of all threads; a
+ * mismatch means that mutual exclusion was broken, and the test ends
+ * with FAILURE.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/spinlock.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+static int nthreads;
+module_param(nthreads, int, 0444);
+MODULE_PARM_DESC(nthreads, "Number of test threads (default: online CPUs)");
+
+static bool spread;
+module_param(spread, bool, 0444);
+MODULE_PARM_DESC(spread, "Take the CPUs round-robin across NUMA nodes");
+
+static int cs_loops = 10;
+module_param(cs_loops, int, 0444);
+MODULE_PARM_DESC(cs_loops, "cpu_relax() loops inside the critical section");
+
+static int ncs_loops;
+module_param(ncs_loops, int, 0444);
+MODULE_PARM_DESC(ncs_loops, "cpu_relax() loops between two acquisitions");
+
+static int stat_interval = 60;
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval,
+		 "Number of seconds between stats printk()s, 0 for only at rmmod");
+
+/* The lock and the data it protects share a cache line, as is usual */
+static struct {
+	spinlock_t lock;
+	unsigned long count;
+} torture_lock ____cacheline_aligned_in_smp;
+
+struct torture_thread {
+	struct task_struct *task;
+	unsigned long acquired;
+	unsigned long reported;	/* acquired as of the last stats printk */
+} ____cacheline_aligned_in_smp;
+
+static struct torture_thread *torture_threads;
+static struct task_struct *stats_task;
+static int nr_nodes, max_distance;
+static ktime_t stats_last;
+
+static int lock_torture_writer(void *arg)
+{
+	struct torture_thread *t = arg;
+	int i;
+
+	do {
+		spin_lock(&torture_lock.lock);
+		torture_lock.count++;
+		for (i = 0; i < cs_loops; i++)
+			cpu_relax();
+		spin_unlock(&torture_lock.lock);
+		t->acquired++;
+
+		for (i = 0; i < ncs_loops; i++)
+			cpu_relax();
+		cond_resched();
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+static unsigned long per_sec(unsigned long n, s64 us)
+{
+	return div64_u64((u64)n * USEC_PER_SEC, us);
+}
+
+/*
+ * Print the acquisitions since the last call.  Only ever called by the
+ * stats kthread, or at rmmod once that has been stopped.
+ */
+static void lock_torture_stats_print(void)
+{
+	unsigned long total = 0, lo = ULONG_MAX, hi = 0, n;
+	ktime_t now = ktime_get();
+	s64 us = max_t(s64, ktime_us_delta(now, stats_last), 1);
+	int i;
+
+	for (i = 0; i < nthreads; i++) {
+		struct torture_thread *t = &torture_threads[i];
+
+		n = ACCESS_ONCE(t->acquired) - t->reported;
+		t->reported += n;
+		total += n;
+		lo = min(lo, n);
+		hi = max(hi, n);
+	}
+	stats_last = now;
+
+	printk(KERN_ALERT "locktorture: %d threads %d nodes distance %d: "
+	       "%lu acq/s, per thread min %lu max %lu\n",
+	       nthreads, nr_nodes, max_distance, per_sec(total, us),
+	       per_sec(lo, us), per_sec(hi, us));
+}
+
+static int lock_torture_stats(void *arg)
+{
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		lock_torture_stats_print();
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+static void lock_torture_print_module_parms(const char *tag)
+{
+	printk(KERN_ALERT "locktorture: %s spinlocks: nthreads=%d spread=%d "
+	       "cs_loops=%d ncs_loops=%d stat_interval=%d: %s\n",
+	       IS_ENABLED(CONFIG_QUEUED_SPINLOCKS) ? "queued" : "arch",
+	       nthreads, spread, cs_loops, ncs_loops, stat_interval, tag);
+}
+
+/*
+ * Order the online CPUs: node after node, or one CPU of every node in
+ * turn if @spread.  Returns the number of CPUs.
+ */
+static int build_cpu_order(int *cpu_order)
+{
+	int n = 0, node, cpu, k;
+	bool found;
+
+	if (!spread) {
+		for_each_online_node(node)
+			for_each_cpu_and(cpu, cpumask_of_node(node),
+					 cpu_online_mask)
+				cpu_order[n++] = cpu;
+		return n;
+	}
+
+	for (k = 0; ; k++) {
+		found = false;
+		for_each_online_node(node) {
+			int i = 0;
+
+			for_each_cpu_and(cpu, cpumask_of_node(node),
+					 cpu_online_mask) {
+				if (i++ == k) {
+					cpu_order[n++] = cpu;
+					found = true;
+					break;
+				}
+			}
+		}
+		if (!found)
+			return n;
+	}
+}
+
+/* Number of nodes used by the first @threads CPUs, and their distance */
+static void nodes_used(const int *cpu_order, int threads)
+{
+	nodemask_t used = NODE_MASK_NONE;
+	int i, a, b;
+
+	for (i = 0; i < threads; i++)
+		node_set(cpu_to_node(cpu_order[i]), used);
+
+	nr_nodes = nodes_weight(used);
+	max_distance = 0;
+	for_each_node_mask(a, used)
+		for_each_node_mask(b, used)
+			max_distance = max(max_distance, node_distance(a, b));
+}
+
+static void lock_torture_stop_threads(void)
+{
+	int i;
+
+	if (stats_task)
+		kthread_stop(stats_task);
+	stats_task = NULL;
+
+	for (i = 0; i < nthreads; i++) {
+		if (torture_threads[i].task)
+			kthread_stop(torture_threads[i].task);
+		torture_threads[i].task = NULL;
+	}
+}
+
+static void __exit lock_torture_cleanup(void)
+{
+	unsigned long total = 0;
+	int i;
+
+	lock_torture_stop_threads();
+	lock_torture_stats_print();  /* -After- the stats thread is stopped! */
+
+	for (i = 0; i < nthreads; i++)
+		total += torture_threads[i].acquired;
+	kfree(torture_threads);
+
+	if (total != torture_lock.count)
+		lock_torture_print_module_parms("End of test: FAILURE");
+	else
+		lock_torture_print_module_parms("End of test: SUCCESS");
+}
+module_exit(lock_torture_cleanup);
+
+static int __init lock_torture_init(void)
+{
+	struct torture_thread *t;
+	int *cpu_order;
+	int i, nr_cpus, err = 0;
+
+	if (cs_loops < 0 || ncs_loops < 0 || stat_interval < 0)
+		return -EINVAL;
+
+	cpu_order = kcalloc(nr_cpu_ids, sizeof(*cpu_order), GFP_KERNEL);
+	if (!cpu_order)
+		return -ENOMEM;
+
+	get_online_cpus();
+	nr_cpus = build_cpu_order(cpu_order);
+	if (nthreads <= 0 || nthreads > nr_cpus)
+		nthreads = nr_cpus;
+	nodes_used(cpu_order, nthreads);
+
+	torture_threads = kcalloc(nthreads, sizeof(*torture_threads),
+				  GFP_KERNEL);
+	if (!torture_threads) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock_init(&torture_lock.lock);
+	torture_lock.count = 0;
+	lock_torture_print_module_parms("Start of test");
+	stats_last = ktime_get();
+
+	for (i = 0; i < nthreads; i++) {
+		t = &torture_threads[i];
+		t->task = kthread_create(lock_torture_writer, t,
+					 "locktorture/%d", i);
+		if (IS_ERR(t->task)) {
+			err = PTR_ERR(t->task);
+			t->task = NULL;
+			goto out;
+		}
+		kthread_bind(t->task, cpu_order[i]);
+		wake_up_process(t->task);
+	}
+
+	if (stat_interval > 0) {
+		stats_task = kthread_run(lock_torture_stats, NULL,
+					 "locktorture_stats");
+		if (IS_ERR(stats_task)) {
+			err = PTR_ERR(stats_task);
+			stats_task = NULL;
+			goto out;
+		}
+	}
+
+out:
+	put_online_cpus();
+	kfree(cpu_order);
+	if (err && torture_threads) {
+		lock_torture_stop_threads();
+		kfree(torture_threads);
+	}
+	return err;
+}
+module_init(lock_torture_init);
+MODULE_LICENSE("GPL");
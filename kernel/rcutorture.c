@@ -46,6 +46,8 @@
 #include <linux/stat.h>
 #include <linux/srcu.h>
 #include <linux/slab.h>
+#include <linux/log2.h>
+#include <trace/events/irq.h>
 #include <asm/byteorder.h>
 
 MODULE_LICENSE("GPL");
@@ -67,6 +69,9 @@ static int fqs_stutter = 3;	/* Wait time between bursts (s). */
 static int test_boost = 1;	/* Test RCU prio boost: 0=no, 1=maybe, 2=yes. */
 static int test_boost_interval = 7; /* Interval between boost tests, seconds. */
 static int test_boost_duration = 4; /* Duration of each boost test, seconds. */
+static int cbflood;		/* # callbacks per flood burst, 0 to disable. */
+static int cbflood_holdoff = 100; /* Wait time between bursts (ms). */
+static int softirq_hist;	/* Histogram RCU_SOFTIRQ durations. */
 static char *torture_type = "rcu"; /* What RCU implementation to torture. */
 
 module_param(nreaders, int, 0444);
@@ -97,6 +102,12 @@ module_param(test_boost_interval, int, 0444);
 MODULE_PARM_DESC(test_boost_interval, "Interval between boost tests, seconds.");
 module_param(test_boost_duration, int, 0444);
 MODULE_PARM_DESC(test_boost_duration, "Duration of each boost test, seconds.");
+module_param(cbflood, int, 0444);
+MODULE_PARM_DESC(cbflood, "Callbacks per CPU per flood burst, 0 to disable");
+module_param(cbflood_holdoff, int, 0444);
+MODULE_PARM_DESC(cbflood_holdoff, "Wait time between flood bursts (ms)");
+module_param(softirq_hist, bool, 0444);
+MODULE_PARM_DESC(softirq_hist, "Histogram RCU_SOFTIRQ durations per CPU");
 module_param(torture_type, charp, 0444);
 MODULE_PARM_DESC(torture_type, "Type of RCU to torture (rcu, rcu_bh, srcu)");
 
@@ -119,6 +130,7 @@ static struct task_struct *shuffler_task;
 static struct task_struct *stutter_task;
 static struct task_struct *fqs_task;
 static struct task_struct *boost_tasks[NR_CPUS];
+static struct task_struct **cbflood_tasks;
 
 #define RCU_TORTURE_PIPE_LEN 10
 
@@ -296,6 +308,7 @@ struct rcu_torture_ops {
 	void (*readunlock)(int idx);
 	int (*completed)(void);
 	void (*deferred_free)(struct rcu_torture *p);
+	void (*call)(struct rcu_head *head, void (*func)(struct rcu_head *head));
 	void (*sync)(void);
 	void (*cb_barrier)(void);
 	void (*fqs)(void);
@@ -386,6 +399,7 @@ static struct rcu_torture_ops rcu_ops = {
 	.readunlock	= rcu_torture_read_unlock,
 	.completed	= rcu_torture_completed,
 	.deferred_free	= rcu_torture_deferred_free,
+	.call		= call_rcu,
 	.sync		= synchronize_rcu,
 	.cb_barrier	= rcu_barrier,
 	.fqs		= rcu_force_quiescent_state,
@@ -488,6 +502,7 @@ static struct rcu_torture_ops rcu_bh_ops = {
 	.readunlock	= rcu_bh_torture_read_unlock,
 	.completed	= rcu_bh_torture_completed,
 	.deferred_free	= rcu_bh_torture_deferred_free,
+	.call		= call_rcu_bh,
 	.sync		= synchronize_rcu_bh,
 	.cb_barrier	= rcu_barrier_bh,
 	.fqs		= rcu_bh_force_quiescent_state,
@@ -659,6 +674,7 @@ static struct rcu_torture_ops sched_ops = {
 	.readunlock	= sched_torture_read_unlock,
 	.completed	= rcu_no_completed,
 	.deferred_free	= rcu_sched_torture_deferred_free,
+	.call		= call_rcu_sched,
 	.sync		= synchronize_sched,
 	.cb_barrier	= rcu_barrier_sched,
 	.fqs		= rcu_sched_force_quiescent_state,
@@ -839,6 +855,146 @@ rcu_torture_fqs(void *arg)
 	return 0;
 }
 
+static atomic_long_t n_rcu_torture_cbflood;
+
+static void rcu_torture_cbflood_cb(struct rcu_head *rhp)
+{
+	atomic_long_inc(&n_rcu_torture_cbflood);
+}
+
+/*
+ * RCU torture callback-flood kthread, one bound to each CPU.  Repeatedly
+ * queues bursts of cbflood callbacks and waits for them to be invoked,
+ * loading the CPU's callback processing, or the rcuo kthreads if the
+ * CPU is a no-CBs CPU.
+ */
+static int
+rcu_torture_cbflood(void *arg)
+{
+	int i;
+	struct rcu_head *rhp;
+
+	VERBOSE_PRINTK_STRING("rcu_torture_cbflood task started");
+	rhp = kcalloc(cbflood, sizeof(*rhp), GFP_KERNEL);
+	if (!rhp)
+		VERBOSE_PRINTK_ERRSTRING("out of memory for cbflood");
+	while (rhp && !kthread_should_stop() &&
+	       fullstop == FULLSTOP_DONTSTOP) {
+		for (i = 0; i < cbflood; i++)
+			cur_ops->call(&rhp[i], rcu_torture_cbflood_cb);
+		cur_ops->cb_barrier();
+		schedule_timeout_interruptible(msecs_to_jiffies(cbflood_holdoff));
+		rcu_stutter_wait("rcu_torture_cbflood");
+	}
+	kfree(rhp);
+	VERBOSE_PRINTK_STRING("rcu_torture_cbflood task stopping");
+	rcutorture_shutdown_absorb("rcu_torture_cbflood");
+	while (!kthread_should_stop())
+		schedule_timeout_uninterruptible(1);
+	return 0;
+}
+
+/*
+ * Histogram of RCU_SOFTIRQ handler durations: bucket 0 counts runs
+ * shorter than 1us, bucket i runs of [2^(i-1), 2^i) us, and the last
+ * bucket everything longer.
+ */
+#define RCU_TORTURE_SOFTIRQ_BUCKETS 16
+
+struct rcu_torture_softirq {
+	u64 start;
+	u64 max;
+	unsigned long hist[RCU_TORTURE_SOFTIRQ_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct rcu_torture_softirq, rcu_torture_softirq);
+static bool rcu_torture_softirq_registered;
+
+static void rcu_torture_softirq_entry(void *ignore, unsigned int vec_nr)
+{
+	if (vec_nr == RCU_SOFTIRQ)
+		__this_cpu_write(rcu_torture_softirq.start, local_clock());
+}
+
+static void rcu_torture_softirq_exit(void *ignore, unsigned int vec_nr)
+{
+	struct rcu_torture_softirq *rts;
+	unsigned long us;
+	u64 delta;
+	int b;
+
+	if (vec_nr != RCU_SOFTIRQ)
+		return;
+	rts = &__get_cpu_var(rcu_torture_softirq);
+	if (!rts->start)
+		return;  /* Probe registered while the handler ran. */
+	delta = local_clock() - rts->start;
+	rts->start = 0;
+	if (delta > rts->max)
+		rts->max = delta;
+	us = (unsigned long)div_u64(delta, NSEC_PER_USEC);
+	b = us ? ilog2(us) + 1 : 0;
+	if (b >= RCU_TORTURE_SOFTIRQ_BUCKETS)
+		b = RCU_TORTURE_SOFTIRQ_BUCKETS - 1;
+	rts->hist[b]++;
+}
+
+static int rcu_torture_softirq_init(void)
+{
+	int ret;
+
+	ret = register_trace_softirq_entry(rcu_torture_softirq_entry, NULL);
+	if (ret)
+		return ret;
+	ret = register_trace_softirq_exit(rcu_torture_softirq_exit, NULL);
+	if (ret) {
+		unregister_trace_softirq_entry(rcu_torture_softirq_entry, NULL);
+		tracepoint_synchronize_unregister();
+		return ret;
+	}
+	rcu_torture_softirq_registered = true;
+	return 0;
+}
+
+static void rcu_torture_softirq_cleanup(void)
+{
+	if (!rcu_torture_softirq_registered)
+		return;
+	unregister_trace_softirq_exit(rcu_torture_softirq_exit, NULL);
+	unregister_trace_softirq_entry(rcu_torture_softirq_entry, NULL);
+	tracepoint_synchronize_unregister();
+	rcu_torture_softirq_registered = false;
+}
+
+/*
+ * Print the RCU_SOFTIRQ histogram, one line per CPU, marking the
+ * no-CBs CPUs.  Printed directly since it does not fit in printk_buf
+ * on large systems.
+ */
+static void rcu_torture_softirq_print(void)
+{
+	int cpu;
+	int i;
+	int n;
+	char buf[RCU_TORTURE_SOFTIRQ_BUCKETS * 12];
+	struct rcu_torture_softirq *rts;
+
+	if (!rcu_torture_softirq_registered)
+		return;
+	for_each_online_cpu(cpu) {
+		rts = &per_cpu(rcu_torture_softirq, cpu);
+		n = 0;
+		for (i = 0; i < RCU_TORTURE_SOFTIRQ_BUCKETS; i++)
+			n += snprintf(&buf[n], sizeof(buf) - n, " %lu",
+				      rts->hist[i]);
+		printk(KERN_ALERT "%s" TORTURE_FLAG
+		       "Softirq CPU %d%s: max %llu ns hist:%s\n",
+		       torture_type, cpu,
+		       rcu_is_nocb_cpu(cpu) ? " (nocb)" : "",
+		       (unsigned long long)rts->max, buf);
+	}
+}
+
 /*
  * RCU torture writer kthread.  Repeatedly substitutes a new structure
  * for that pointed to by rcu_torture_current, freeing the old structure
@@ -1069,6 +1225,9 @@ rcu_torture_printk(char *page)
 		       n_rcu_torture_boost_failure,
 		       n_rcu_torture_boosts,
 		       n_rcu_torture_timers);
+	if (cbflood)
+		cnt += sprintf(&page[cnt], " cbf: %ld",
+			       atomic_long_read(&n_rcu_torture_cbflood));
 	if (atomic_read(&n_rcu_torture_mberror) != 0 ||
 	    n_rcu_torture_boost_ktrerror != 0 ||
 	    n_rcu_torture_boost_rterror != 0 ||
@@ -1114,6 +1273,7 @@ rcu_torture_stats_print(void)
 
 	cnt = rcu_torture_printk(printk_buf);
 	printk(KERN_ALERT "%s", printk_buf);
+	rcu_torture_softirq_print();
 }
 
 /*
@@ -1232,12 +1392,14 @@ rcu_torture_print_module_parms(struct rcu_torture_ops *cur_ops, char *tag)
 		"shuffle_interval=%d stutter=%d irqreader=%d "
 		"fqs_duration=%d fqs_holdoff=%d fqs_stutter=%d "
 		"test_boost=%d/%d test_boost_interval=%d "
-		"test_boost_duration=%d\n",
+		"test_boost_duration=%d cbflood=%d cbflood_holdoff=%d "
+		"softirq_hist=%d\n",
 		torture_type, tag, nrealreaders, nfakewriters,
 		stat_interval, verbose, test_no_idle_hz, shuffle_interval,
 		stutter, irqreader, fqs_duration, fqs_holdoff, fqs_stutter,
 		test_boost, cur_ops->can_boost,
-		test_boost_interval, test_boost_duration);
+		test_boost_interval, test_boost_duration, cbflood,
+		cbflood_holdoff, softirq_hist);
 }
 
 static struct notifier_block rcutorture_shutdown_nb = {
@@ -1385,6 +1547,19 @@ rcu_torture_cleanup(void)
 		kthread_stop(fqs_task);
 	}
 	fqs_task = NULL;
+
+	if (cbflood_tasks) {
+		for (i = 0; i < nr_cpu_ids; i++) {
+			if (cbflood_tasks[i]) {
+				VERBOSE_PRINTK_STRING(
+					"Stopping rcu_torture_cbflood task");
+				kthread_stop(cbflood_tasks[i]);
+			}
+			cbflood_tasks[i] = NULL;
+		}
+		kfree(cbflood_tasks);
+		cbflood_tasks = NULL;
+	}
 	if ((test_boost == 1 && cur_ops->can_boost) ||
 	    test_boost == 2) {
 		unregister_cpu_notifier(&rcutorture_cpu_nb);
@@ -1398,6 +1573,7 @@ rcu_torture_cleanup(void)
 		cur_ops->cb_barrier();
 
 	rcu_torture_stats_print();  /* -After- the stats thread is stopped! */
+	rcu_torture_softirq_cleanup();
 
 	if (cur_ops->cleanup)
 		cur_ops->cleanup();
@@ -1587,6 +1763,42 @@ rcu_torture_init(void)
 			goto unwind;
 		}
 	}
+	if (cbflood < 0)
+		cbflood = 0;
+	if (cbflood_holdoff < 0)
+		cbflood_holdoff = 0;
+	if (cbflood && cur_ops->call && cur_ops->cb_barrier) {
+		/* Create one callback-flood thread per online CPU */
+		cbflood_tasks = kcalloc(nr_cpu_ids, sizeof(cbflood_tasks[0]),
+					GFP_KERNEL);
+		if (cbflood_tasks == NULL) {
+			VERBOSE_PRINTK_ERRSTRING("out of memory");
+			firsterr = -ENOMEM;
+			goto unwind;
+		}
+		for_each_online_cpu(cpu) {
+			struct task_struct *t;
+
+			t = kthread_create(rcu_torture_cbflood, NULL,
+					   "rcu_torture_cbflood");
+			if (IS_ERR(t)) {
+				firsterr = PTR_ERR(t);
+				VERBOSE_PRINTK_ERRSTRING("Failed to create cbflood");
+				goto unwind;
+			}
+			kthread_bind(t, cpu);
+			cbflood_tasks[cpu] = t;
+			wake_up_process(t);
+		}
+	}
+	if (softirq_hist) {
+		i = rcu_torture_softirq_init();
+		if (i) {
+			firsterr = i;
+			VERBOSE_PRINTK_ERRSTRING("Failed to register softirq probes");
+			goto unwind;
+		}
+	}
 	if (test_boost_interval < 1)
 		test_boost_interval = 1;
 	if (test_boost_duration < 2)
@@ -26,6 +26,7 @@
 
 #include <linux/delay.h>
 #include <linux/stop_machine.h>
+#include <linux/tick.h>
 
 #define RCU_KTHREAD_PRIO 1
 
@@ -72,7 +73,7 @@ static void __init rcu_bootup_announce_oddness(void)
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
-struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt);
+struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt, 'p');
 DEFINE_PER_CPU(struct rcu_data, rcu_preempt_data);
 static struct rcu_state *rcu_state = &rcu_preempt_state;
 
@@ -668,7 +669,7 @@ static void rcu_preempt_do_callbacks(void)
  */
 void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_preempt_state);
+	__call_rcu(head, func, &rcu_preempt_state, true);
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
@@ -2024,3 +2025,301 @@ int rcu_needs_cpu(int cpu)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload RCU callbacks from the CPUs given with the rcu_nocbs= boot
+ * parameter.  A callback queued on one of these CPUs goes to a per-CPU,
+ * per-flavor list that is drained by an "rcuo" kthread, which waits for
+ * a grace period and then invokes the callbacks.  These kthreads are
+ * not bound to their CPU, so they can be moved to housekeeping CPUs,
+ * leaving the no-CBs CPUs free of RCU_SOFTIRQ callback processing.
+ * Grace-period detection is unchanged: a no-CBs CPU still reports its
+ * own quiescent states.
+ */
+
+static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+
+/* Parse the boot-time rcu_nocbs= CPU list. */
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+bool rcu_is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+EXPORT_SYMBOL_GPL(rcu_is_nocb_cpu);
+
+/*
+ * Settle the set of no-CBs CPUs before the first callback is queued.
+ * CPUs running in full dynticks mode must not depend on the tick to
+ * invoke callbacks, so they are always no-CBs CPUs.
+ */
+static void __init rcu_init_nocb(void)
+{
+	char buf[128];
+
+#ifdef CONFIG_NO_HZ_FULL
+	if (tick_nohz_full_running) {
+		if (!have_rcu_nocb_mask) {
+			if (WARN_ON(!zalloc_cpumask_var(&rcu_nocb_mask,
+							GFP_KERNEL)))
+				return;
+			have_rcu_nocb_mask = true;
+		}
+		cpumask_or(rcu_nocb_mask, rcu_nocb_mask, tick_nohz_full_mask);
+	}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+	if (!have_rcu_nocb_mask)
+		return;
+	cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "\tOffload RCU callbacks from CPUs: %s.\n", buf);
+}
+
+/* Wake up a no-CBs kthread on behalf of a caller with irqs disabled. */
+static void rcu_nocb_wakeup(struct irq_work *work)
+{
+	struct rcu_data *rdp = container_of(work, struct rcu_data,
+					    nocb_wakeup);
+
+	wake_up(&rdp->nocb_wq);
+}
+
+/*
+ * Enqueue the callback on the no-CBs list of the specified CPU, and
+ * wake up its rcuo kthread if the list was empty.  Returns false if
+ * the CPU is not a no-CBs CPU, in which case the caller must queue the
+ * callback normally.  Called with interrupts disabled, flags being the
+ * caller's interrupt state: a caller that had interrupts disabled might
+ * hold scheduler locks, so its wakeup is deferred to irq_work.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    unsigned long flags)
+{
+	struct rcu_head **old_rhpp;
+	long len;
+
+	if (!rcu_is_nocb_cpu(rdp->cpu))
+		return false;
+
+	len = atomic_long_inc_return(&rdp->nocb_q_count);
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+
+	if (__is_kfree_rcu_offset((unsigned long)rhp->func))
+		trace_rcu_kfree_callback(rdp->rsp->name, rhp,
+					 (unsigned long)rhp->func, len);
+	else
+		trace_rcu_callback(rdp->rsp->name, rhp, len);
+
+	/* If the list was empty, the kthread might be sleeping. */
+	if (old_rhpp == &rdp->nocb_head) {
+		if (irqs_disabled_flags(flags))
+			irq_work_queue(&rdp->nocb_wakeup);
+		else
+			wake_up(&rdp->nocb_wq);
+	}
+	return true;
+}
+
+struct rcu_nocb_sync {
+	struct rcu_head head;
+	struct completion completion;
+};
+
+static void rcu_nocb_gp_done(struct rcu_head *head)
+{
+	struct rcu_nocb_sync *rns = container_of(head, struct rcu_nocb_sync,
+						 head);
+
+	complete(&rns->completion);
+}
+
+/*
+ * Wait for a grace period of the flavor of the specified rcu_data.
+ * The callback goes on the normal callback list of whatever CPU this
+ * runs on: queueing it on a no-CBs list could leave two rcuo kthreads
+ * waiting on each other.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_nocb_sync rns;
+
+	init_rcu_head_on_stack(&rns.head);
+	init_completion(&rns.completion);
+	__call_rcu(&rns.head, rcu_nocb_gp_done, rdp->rsp, false);
+	wait_for_completion(&rns.completion);
+	destroy_rcu_head_on_stack(&rns.head);
+}
+
+/*
+ * Per-CPU, per-flavor kthread that takes the callbacks queued on a
+ * no-CBs CPU, waits for a grace period, and invokes them.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	long c;
+	struct rcu_head *list;
+	struct rcu_head *next;
+	struct rcu_head **tail;
+	struct rcu_data *rdp = arg;
+
+	for (;;) {
+		/* Wait for callbacks to be queued. */
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+
+		/* Take the whole list, leaving an empty one for enqueuers. */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		ACCESS_ONCE(rdp->nocb_p_count) += c;
+
+		rcu_nocb_wait_gp(rdp);
+
+		/* Invoke the callbacks, ->next of the last one is tail. */
+		trace_rcu_batch_start(rdp->rsp->name, c, -1);
+		c = 0;
+		while (list) {
+			next = ACCESS_ONCE(list->next);
+			/* An enqueue might still be linking in the next one. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = ACCESS_ONCE(list->next);
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			__rcu_reclaim(rdp->rsp->name, list);
+			local_bh_enable();
+			list = next;
+			c++;
+		}
+		trace_rcu_batch_end(rdp->rsp->name, c);
+		ACCESS_ONCE(rdp->nocb_p_count) -= c;
+		rdp->n_nocbs_invoked += c;
+	}
+	return 0;
+}
+
+/*
+ * The rcuo kthread of an offline no-CBs CPU goes on invoking the
+ * callbacks queued before the CPU went down, where on_each_cpu() in
+ * _rcu_barrier() cannot reach them.  Queue the CPU's barrier callback
+ * behind them.  Whether the kthread still has callbacks cannot be told
+ * reliably while it is moving them off the list, so this is done for
+ * every offline no-CBs CPU.  Called with CPU hotplug held off.
+ */
+static void rcu_barrier_nocb_offline(struct rcu_state *rsp)
+{
+	int cpu;
+	unsigned long flags;
+	struct rcu_data *rdp;
+	struct rcu_head *head;
+
+	if (!have_rcu_nocb_mask)
+		return;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (cpu_online(cpu) || !ACCESS_ONCE(rdp->nocb_kthread))
+			continue;
+		head = &per_cpu(rcu_barrier_head, cpu);
+		debug_rcu_head_queue(head);
+		head->func = rcu_barrier_callback;
+		head->next = NULL;
+		atomic_inc(&rcu_barrier_cpu_count);
+		local_irq_save(flags);
+		__call_rcu_nocb(rdp, head, flags);
+		local_irq_restore(flags);
+	}
+}
+
+/* Initialize the no-CBs fields of a CPU's per-flavor rcu_data. */
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+	init_irq_work(&rdp->nocb_wakeup, rcu_nocb_wakeup);
+}
+
+/*
+ * Create the rcuo kthreads of one RCU flavor, allowing them to run on
+ * the specified CPUs.  An empty mask leaves them free to run anywhere.
+ */
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp,
+					   const struct cpumask *cm)
+{
+	int cpu;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_create(rcu_nocb_kthread, rdp,
+				   "rcuo%c/%d", rsp->abbr, cpu);
+		BUG_ON(IS_ERR(t));
+		if (!cpumask_empty(cm))
+			set_cpus_allowed_ptr(t, cm);
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+		wake_up_process(t);
+	}
+}
+
+/*
+ * Spawn the rcuo kthreads of all flavors, by default on the CPUs that
+ * are not no-CBs CPUs.
+ */
+static int __init rcu_spawn_all_nocb_kthreads(void)
+{
+	cpumask_var_t cm;
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	if (!zalloc_cpumask_var(&cm, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_andnot(cm, cpu_possible_mask, rcu_nocb_mask);
+	rcu_spawn_nocb_kthreads(&rcu_sched_state, cm);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state, cm);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state, cm);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	free_cpumask_var(cm);
+	return 0;
+}
+early_initcall(rcu_spawn_all_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static void __init rcu_init_nocb(void)
+{
+}
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    unsigned long flags)
+{
+	return false;
+}
+
+static void rcu_barrier_nocb_offline(struct rcu_state *rsp)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
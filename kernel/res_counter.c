@@ -17,84 +17,80 @@
 void res_counter_init(struct res_counter *counter, struct res_counter *parent)
 {
 	spin_lock_init(&counter->lock);
+	atomic64_set(&counter->usage, 0);
 	counter->limit = RESOURCE_MAX;
 	counter->soft_limit = RESOURCE_MAX;
 	counter->parent = parent;
 }
 
-int res_counter_charge_locked(struct res_counter *counter, unsigned long val)
+/*
+ * Charging does not take counter->lock: the usage is updated with one
+ * atomic operation and checked against the limit afterwards. A charge
+ * that went over the limit is backed out again, so chargers racing
+ * close to the limit may fail spuriously, but the usage never stays
+ * above it. Each level of a hierarchy costs one atomic operation on
+ * its own cache line instead of a lock round trip.
+ */
+static int res_counter_try_charge(struct res_counter *counter,
+				  unsigned long val)
 {
-	if (counter->usage + val > counter->limit) {
+	u64 usage;
+
+	usage = atomic64_add_return(val, &counter->usage);
+	if (usage > ACCESS_ONCE(counter->limit)) {
+		atomic64_sub(val, &counter->usage);
 		counter->failcnt++;
 		return -ENOMEM;
 	}
 
-	counter->usage += val;
-	if (counter->usage > counter->max_usage)
-		counter->max_usage = counter->usage;
+	/* racy, but it is a watermark only */
+	if (usage > counter->max_usage)
+		counter->max_usage = usage;
 	return 0;
 }
 
+static void res_counter_uncharge_one(struct res_counter *counter,
+				     unsigned long val)
+{
+	s64 usage = atomic64_sub_return(val, &counter->usage);
+
+	if (WARN_ON(usage < 0))
+		atomic64_sub(usage, &counter->usage);
+}
+
 int res_counter_charge(struct res_counter *counter, unsigned long val,
 			struct res_counter **limit_fail_at)
 {
-	int ret;
-	unsigned long flags;
 	struct res_counter *c, *u;
 
 	*limit_fail_at = NULL;
-	local_irq_save(flags);
 	for (c = counter; c != NULL; c = c->parent) {
-		spin_lock(&c->lock);
-		ret = res_counter_charge_locked(c, val);
-		spin_unlock(&c->lock);
-		if (ret < 0) {
+		if (res_counter_try_charge(c, val) < 0) {
 			*limit_fail_at = c;
 			goto undo;
 		}
 	}
-	ret = 0;
-	goto done;
+	return 0;
 undo:
-	for (u = counter; u != c; u = u->parent) {
-		spin_lock(&u->lock);
-		res_counter_uncharge_locked(u, val);
-		spin_unlock(&u->lock);
-	}
-done:
-	local_irq_restore(flags);
-	return ret;
-}
-
-void res_counter_uncharge_locked(struct res_counter *counter, unsigned long val)
-{
-	if (WARN_ON(counter->usage < val))
-		val = counter->usage;
-
-	counter->usage -= val;
+	for (u = counter; u != c; u = u->parent)
+		res_counter_uncharge_one(u, val);
+	return -ENOMEM;
 }
 
 void res_counter_uncharge(struct res_counter *counter, unsigned long val)
 {
-	unsigned long flags;
 	struct res_counter *c;
 
-	local_irq_save(flags);
-	for (c = counter; c != NULL; c = c->parent) {
-		spin_lock(&c->lock);
-		res_counter_uncharge_locked(c, val);
-		spin_unlock(&c->lock);
-	}
-	local_irq_restore(flags);
+	for (c = counter; c != NULL; c = c->parent)
+		res_counter_uncharge_one(c, val);
 }
 
 
 static inline unsigned long long *
 res_counter_member(struct res_counter *counter, int member)
 {
+	/* the usage is atomic64_t and is only changed by charging */
 	switch (member) {
-	case RES_USAGE:
-		return &counter->usage;
 	case RES_MAX_USAGE:
 		return &counter->max_usage;
 	case RES_LIMIT:
@@ -109,19 +105,26 @@ res_counter_member(struct res_counter *counter, int member)
 	return NULL;
 }
 
+static u64 res_counter_get(struct res_counter *counter, int member)
+{
+	if (member == RES_USAGE)
+		return atomic64_read(&counter->usage);
+	return *res_counter_member(counter, member);
+}
+
 ssize_t res_counter_read(struct res_counter *counter, int member,
 		const char __user *userbuf, size_t nbytes, loff_t *pos,
 		int (*read_strategy)(unsigned long long val, char *st_buf))
 {
-	unsigned long long *val;
+	unsigned long long val;
 	char buf[64], *s;
 
 	s = buf;
-	val = res_counter_member(counter, member);
+	val = res_counter_get(counter, member);
 	if (read_strategy)
-		s += read_strategy(*val, s);
+		s += read_strategy(val, s);
 	else
-		s += sprintf(s, "%llu\n", *val);
+		s += sprintf(s, "%llu\n", val);
 	return simple_read_from_buffer((void __user *)userbuf, nbytes,
 			pos, buf, s - buf);
 }
@@ -133,7 +136,7 @@ u64 res_counter_read_u64(struct res_counter *counter, int member)
 	u64 ret;
 
 	spin_lock_irqsave(&counter->lock, flags);
-	ret = *res_counter_member(counter, member);
+	ret = res_counter_get(counter, member);
 	spin_unlock_irqrestore(&counter->lock, flags);
 
 	return ret;
@@ -141,7 +144,7 @@ u64 res_counter_read_u64(struct res_counter *counter, int member)
 #else
 u64 res_counter_read_u64(struct res_counter *counter, int member)
 {
-	return *res_counter_member(counter, member);
+	return res_counter_get(counter, member);
 }
 #endif
 
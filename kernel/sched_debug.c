@@ -240,6 +240,22 @@ void print_rt_rq(struct seq_file *m, int cpu, struct rt_rq *rt_rq)
 #undef P
 }
 
+void print_dl_rq(struct seq_file *m, int cpu, struct dl_rq *dl_rq)
+{
+	SEQ_printf(m, "\ndl_rq[%d]:\n", cpu);
+
+#define P(x) \
+	SEQ_printf(m, "  .%-30s: %Ld\n", #x, (long long)(dl_rq->x))
+
+	P(dl_nr_running);
+#ifdef CONFIG_SCHEDSTATS
+	P(nr_deadline_misses);
+	P(nr_overruns);
+#endif
+
+#undef P
+}
+
 extern __read_mostly int sched_clock_running;
 
 static void print_cpu(struct seq_file *m, int cpu)
@@ -302,6 +318,7 @@ static void print_cpu(struct seq_file *m, int cpu)
 	spin_lock_irqsave(&sched_debug_lock, flags);
 	print_cfs_stats(m, cpu);
 	print_rt_stats(m, cpu);
+	print_dl_stats(m, cpu);
 
 	rcu_read_lock();
 	print_rq(m, rq, cpu);
@@ -453,6 +470,8 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.statistics.nr_wakeups_affine_attempts);
 	P(se.statistics.nr_wakeups_passive);
 	P(se.statistics.nr_wakeups_idle);
+	P(se.statistics.nr_dl_deadline_misses);
+	P(se.statistics.nr_dl_overruns);
 
 	{
 		u64 avg_atom, avg_per_cpu;
@@ -484,6 +503,24 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.load.weight);
 	P(policy);
 	P(prio);
+	if (task_has_dl_policy(p)) {
+		PN(dl.dl_runtime);
+		PN(dl.dl_deadline);
+		PN(dl.dl_period);
+	}
+#ifdef CONFIG_NUMA_BALANCING
+	P(numa_scan_seq);
+	P(numa_scan_period);
+	P(numa_preferred_nid);
+	P(numa_pages_migrated);
+	if (p->numa_faults) {
+		int nid;
+
+		for (nid = 0; nid < nr_node_ids; nid++)
+			SEQ_printf(m, "numa_faults, node %-24d:%21lu\n",
+				   nid, p->numa_faults[nid]);
+	}
+#endif
 #undef PN
 #undef __PN
 #undef P
@@ -23,6 +23,8 @@
 #include <linux/latencytop.h>
 #include <linux/sched.h>
 #include <linux/cpumask.h>
+#include <linux/slab.h>
+#include <linux/mempolicy.h>
 
 /*
  * Targeted preemption latency for CPU-bound tasks:
@@ -662,6 +664,298 @@ update_stats_curr_start(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	se->exec_start = rq_of(cfs_rq)->clock_task;
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Enabled by default on machines with more than one node, see
+ * sched_init_smp().
+ */
+unsigned int sysctl_numa_balancing;
+
+/*
+ * Approximate time (ms) between scans of a task's address space. Each
+ * task adapts its own period between these bounds: it halves while its
+ * faults keep migrating pages and doubles once placement settles.
+ */
+unsigned int sysctl_numa_balancing_scan_period_min = 1000;
+unsigned int sysctl_numa_balancing_scan_period_max = 60000;
+
+/* Portion of address space to scan in MB */
+unsigned int sysctl_numa_balancing_scan_size = 256;
+
+/* Scan @scan_size MB every @scan_period after an initial @scan_delay in ms */
+unsigned int sysctl_numa_balancing_scan_delay = 1000;
+
+/* Find an idle CPU on @nid that @p may run on, or -1 */
+static int task_numa_find_cpu(struct task_struct *p, int nid)
+{
+	int cpu;
+
+	for_each_cpu_and(cpu, cpumask_of_node(nid), tsk_cpus_allowed(p)) {
+		if (idle_cpu(cpu))
+			return cpu;
+	}
+	return -1;
+}
+
+/*
+ * Called once per pass of the scanner over the address space: pick the
+ * node with most faults as the preferred one and move there if a CPU is
+ * free. Otherwise the load balancer will favour that node over time.
+ */
+static void task_numa_placement(struct task_struct *p)
+{
+	int seq, nid, max_nid = -1;
+	unsigned long max_faults = 0;
+
+	seq = ACCESS_ONCE(p->mm->numa_scan_seq);
+	if (p->numa_scan_seq == seq)
+		return;
+	p->numa_scan_seq = seq;
+
+	/* Find the node with the highest number of faults, decaying as we go */
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		unsigned long faults = p->numa_faults[nid];
+
+		p->numa_faults[nid] = faults >> 1;
+		if (faults > max_faults) {
+			max_faults = faults;
+			max_nid = nid;
+		}
+	}
+
+	/* Scan faster while pages are moving, back off once they settle */
+	if (p->numa_migrated_window)
+		p->numa_scan_period = max(sysctl_numa_balancing_scan_period_min,
+					  p->numa_scan_period / 2);
+	else
+		p->numa_scan_period = min(sysctl_numa_balancing_scan_period_max,
+					  p->numa_scan_period * 2);
+	p->numa_migrated_window = 0;
+
+	if (max_nid == -1)
+		return;
+
+	p->numa_preferred_nid = max_nid;
+	if (cpu_to_node(task_cpu(p)) != max_nid) {
+		int cpu = task_numa_find_cpu(p, max_nid);
+
+		if (cpu >= 0)
+			migrate_task_to(p, cpu);
+	}
+}
+
+/*
+ * Got a NUMA hinting fault on a page that now lives on @node.
+ */
+void task_numa_fault(int node, int pages, bool migrated)
+{
+	struct task_struct *p = current;
+
+	if (!sysctl_numa_balancing || !p->mm)
+		return;
+
+	/* Allocate buffer to track faults on a per-node basis */
+	if (unlikely(!p->numa_faults)) {
+		int size = sizeof(*p->numa_faults) * nr_node_ids;
+
+		p->numa_faults = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+		if (!p->numa_faults)
+			return;
+	}
+
+	if (migrated) {
+		p->numa_pages_migrated += pages;
+		p->numa_migrated_window += pages;
+	}
+	p->numa_faults[node] += pages;
+
+	task_numa_placement(p);
+}
+
+void task_numa_free(struct task_struct *p)
+{
+	kfree(p->numa_faults);
+	p->numa_faults = NULL;
+}
+
+static void reset_ptenuma_scan(struct task_struct *p)
+{
+	ACCESS_ONCE(p->mm->numa_scan_seq)++;
+	p->mm->numa_scan_offset = 0;
+}
+
+/* Is it worth sampling this vma for NUMA hinting faults? */
+static bool task_numa_scan_vma(struct vm_area_struct *vma)
+{
+	if (!vma_migratable(vma))
+		return false;
+
+	/* PROT_NONE ptes in an inaccessible vma are not hinting faults */
+	if (!(vma->vm_flags & (VM_READ | VM_WRITE | VM_EXEC)))
+		return false;
+
+	/*
+	 * Read-only file mappings are mostly shared libraries: they are
+	 * mapped by many tasks on many nodes, so there is no right place.
+	 */
+	if (vma->vm_file &&
+	    (vma->vm_flags & (VM_READ | VM_WRITE)) == VM_READ)
+		return false;
+
+	return true;
+}
+
+/*
+ * The expensive part of numa migration is done from return-to-user,
+ * requested by task_tick_numa(). Mark the next sysctl_numa_balancing_scan_size
+ * MB of the address space for NUMA hinting faults.
+ */
+void task_numa_work(struct task_struct *p)
+{
+	unsigned long migrate, next_scan, now = jiffies;
+	struct mm_struct *mm = p->mm;
+	struct vm_area_struct *vma;
+	unsigned long start, end;
+	long pages;
+
+	WARN_ON_ONCE(p != current);
+	p->numa_work = 0;
+
+	if (!mm || (p->flags & PF_EXITING))
+		return;
+
+	/*
+	 * Enforce maximal scan/migration frequency..
+	 */
+	migrate = mm->numa_next_scan;
+	if (time_before(now, migrate))
+		return;
+
+	next_scan = now + msecs_to_jiffies(p->numa_scan_period);
+	if (cmpxchg(&mm->numa_next_scan, migrate, next_scan) != migrate)
+		return;
+
+	pages = sysctl_numa_balancing_scan_size;
+	pages <<= 20 - PAGE_SHIFT; /* MB in pages */
+	if (!pages)
+		return;
+
+	down_read(&mm->mmap_sem);
+	start = mm->numa_scan_offset;
+	vma = find_vma(mm, start);
+	if (!vma) {
+		reset_ptenuma_scan(p);
+		start = 0;
+		vma = mm->mmap;
+	}
+	for (; vma; vma = vma->vm_next) {
+		if (!task_numa_scan_vma(vma))
+			continue;
+
+		start = max(start, vma->vm_start);
+		end = min(vma->vm_end, start + (pages << PAGE_SHIFT));
+		if (start < end) {
+			change_prot_numa(vma, start, end);
+			pages -= (end - start) >> PAGE_SHIFT;
+			start = end;
+		}
+		if (pages <= 0)
+			break;
+	}
+
+	/*
+	 * Resume from where we stopped next time; start over once the
+	 * end of the address space has been reached.
+	 */
+	if (vma)
+		mm->numa_scan_offset = start;
+	else
+		reset_ptenuma_scan(p);
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * Drive the periodic memory faults..
+ */
+static void task_tick_numa(struct rq *rq, struct task_struct *curr)
+{
+	u64 period, now;
+
+	if (!sysctl_numa_balancing)
+		return;
+
+	/*
+	 * We don't care about NUMA placement if we don't have memory.
+	 */
+	if (!curr->mm || (curr->flags & PF_EXITING) || curr->numa_work)
+		return;
+
+	/*
+	 * Using runtime rather than walltime has the dual advantage that
+	 * we (mostly) drive the selection from busy threads and that the
+	 * task needs to have done some actual work before we bother with
+	 * NUMA placement.
+	 */
+	now = curr->se.sum_exec_runtime;
+	period = (u64)curr->numa_scan_period * NSEC_PER_MSEC;
+
+	if (now - curr->node_stamp > period) {
+		curr->node_stamp = now;
+
+		if (!time_before(jiffies, curr->mm->numa_next_scan)) {
+			curr->numa_work = 1;
+			set_tsk_thread_flag(curr, TIF_NOTIFY_RESUME);
+		}
+	}
+}
+
+/* Moving @p from @src_cpu to @dst_cpu brings it to its preferred node */
+static bool migrate_improves_locality(struct task_struct *p,
+				      int src_cpu, int dst_cpu)
+{
+	int src_nid, dst_nid;
+
+	if (!sched_feat(NUMA_FAVOUR_HIGHER) || p->numa_preferred_nid == -1)
+		return false;
+
+	src_nid = cpu_to_node(src_cpu);
+	dst_nid = cpu_to_node(dst_cpu);
+
+	return src_nid != dst_nid && dst_nid == p->numa_preferred_nid;
+}
+
+/* Moving @p from @src_cpu to @dst_cpu takes it off its preferred node */
+static bool migrate_degrades_locality(struct task_struct *p,
+				      int src_cpu, int dst_cpu)
+{
+	int src_nid, dst_nid;
+
+	if (!sched_feat(NUMA_RESIST_LOWER) || p->numa_preferred_nid == -1)
+		return false;
+
+	src_nid = cpu_to_node(src_cpu);
+	dst_nid = cpu_to_node(dst_cpu);
+
+	return src_nid != dst_nid && src_nid == p->numa_preferred_nid;
+}
+#else
+static inline void task_tick_numa(struct rq *rq, struct task_struct *curr)
+{
+}
+
+static inline bool migrate_improves_locality(struct task_struct *p,
+					     int src_cpu, int dst_cpu)
+{
+	return false;
+}
+
+static inline bool migrate_degrades_locality(struct task_struct *p,
+					     int src_cpu, int dst_cpu)
+{
+	return false;
+}
+#endif /* CONFIG_NUMA_BALANCING */
+
 /**************************************************
  * Scheduling class queueing methods:
  */
@@ -2318,10 +2612,130 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return idlest;
 }
 
+/* Working cpumask for select_idle_core. */
+static DEFINE_PER_CPU(cpumask_var_t, select_idle_mask);
+
+#ifdef CONFIG_SCHED_SMT
+/*
+ * Scan the LLC domain for a whole idle core, if the cpus of the domain
+ * were told there is one. A fruitless scan clears the hint, which stays
+ * clear until a core goes idle again.
+ */
+static int select_idle_core(struct task_struct *p, struct sched_domain *sd,
+			    int target)
+{
+	struct cpumask *cpus = __get_cpu_var(select_idle_mask);
+	int core, cpu;
+
+	if (!test_idle_cores(target, false))
+		return -1;
+
+	cpumask_and(cpus, sched_domain_span(sd), tsk_cpus_allowed(p));
+
+	for_each_cpu_wrap(core, cpus, target) {
+		bool idle = true;
+
+		for_each_cpu(cpu, cpu_smt_mask(core)) {
+			cpumask_clear_cpu(cpu, cpus);
+			if (!idle_cpu(cpu))
+				idle = false;
+		}
+
+		if (idle)
+			return core;
+	}
+
+	set_idle_cores(target, 0);
+
+	return -1;
+}
+
 /*
- * Try and locate an idle CPU in the sched_domain.
+ * Scan the siblings of the target, when there are no idle cores left.
  */
-static int select_idle_sibling(struct task_struct *p, int target)
+static int select_idle_smt(struct task_struct *p, struct sched_domain *sd,
+			   int target)
+{
+	int cpu;
+
+	for_each_cpu(cpu, cpu_smt_mask(target)) {
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
+		if (idle_cpu(cpu))
+			return cpu;
+	}
+
+	return -1;
+}
+#else
+static inline int select_idle_core(struct task_struct *p,
+				   struct sched_domain *sd, int target)
+{
+	return -1;
+}
+
+static inline int select_idle_smt(struct task_struct *p,
+				  struct sched_domain *sd, int target)
+{
+	return -1;
+}
+#endif
+
+/*
+ * Scan the LLC domain for an idle cpu. With SIS_PROP, the number of cpus
+ * looked at is bounded by how long this cpu is idle on average over how
+ * long a search has been taking: a mostly busy cpu is woken up by a mostly
+ * busy domain, where a long search is unlikely to find anything.
+ */
+static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd,
+			   int target)
+{
+	struct sched_domain *this_sd;
+	u64 avg_cost, avg_idle, time;
+	s64 delta;
+	int cpu, nr = INT_MAX;
+
+	this_sd = rcu_dereference(__get_cpu_var(sd_llc));
+	if (!this_sd)
+		return -1;
+
+	if (sched_feat(SIS_PROP)) {
+		u64 span_avg;
+
+		/* Very roughly: half the idle time, in units of 1024ns */
+		avg_idle = this_rq()->avg_idle / 512;
+		avg_cost = this_sd->avg_scan_cost + 1;
+
+		span_avg = sd->span_weight * avg_idle;
+		if (span_avg > 4 * avg_cost)
+			nr = div64_u64(span_avg, avg_cost);
+		else
+			nr = 4;
+	}
+
+	time = local_clock();
+
+	for_each_cpu_wrap(cpu, sched_domain_span(sd), target) {
+		if (!--nr)
+			return -1;
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
+		if (idle_cpu(cpu))
+			break;
+	}
+
+	time = local_clock() - time;
+	delta = (s64)(time - this_sd->avg_scan_cost) / 8;
+	this_sd->avg_scan_cost += delta;
+
+	return cpu < nr_cpu_ids ? cpu : -1;
+}
+
+/*
+ * Try and locate an idle CPU in the sched_domain, walking the groups of
+ * all the domains sharing the package; used without SIS_LLC.
+ */
+static int select_idle_group_sibling(struct task_struct *p, int target)
 {
 	int cpu = smp_processor_id();
 	int prev_cpu = task_cpu(p);
@@ -2386,6 +2800,46 @@ done:
 	return target;
 }
 
+/*
+ * Try and locate an idle CPU sharing the cache with @target, @prev being
+ * the cpu the task ran on last.
+ */
+static int select_idle_sibling(struct task_struct *p, int prev, int target)
+{
+	struct sched_domain *sd;
+	int i;
+
+	if (!sched_feat(SIS_LLC))
+		return select_idle_group_sibling(p, target);
+
+	if (idle_cpu(target))
+		return target;
+
+	/*
+	 * If the previous cpu is cache affine and idle, don't be stupid.
+	 */
+	if (prev != target && cpus_share_cache(prev, target) && idle_cpu(prev))
+		return prev;
+
+	sd = rcu_dereference(per_cpu(sd_llc, target));
+	if (!sd)
+		return target;
+
+	i = select_idle_core(p, sd, target);
+	if (i >= 0)
+		return i;
+
+	i = select_idle_cpu(p, sd, target);
+	if (i >= 0)
+		return i;
+
+	i = select_idle_smt(p, sd, target);
+	if (i >= 0)
+		return i;
+
+	return target;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -2464,10 +2918,12 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	}
 
 	if (affine_sd) {
+		int target = prev_cpu;
+
 		if (cpu == prev_cpu || wake_affine(affine_sd, p, sync))
-			prev_cpu = cpu;
+			target = cpu;
 
-		new_cpu = select_idle_sibling(p, prev_cpu);
+		new_cpu = select_idle_sibling(p, prev_cpu, target);
 		goto unlock;
 	}
 
@@ -2801,6 +3257,10 @@ int can_migrate_task(struct task_struct *p, struct rq *rq, int this_cpu,
 		return 0;
 	}
 
+	/* Always allow a move onto the node the task's memory is on */
+	if (migrate_improves_locality(p, cpu_of(rq), this_cpu))
+		return 1;
+
 	/*
 	 * Aggressive migration if:
 	 * 1) task is cache cold, or
@@ -2808,6 +3268,9 @@ int can_migrate_task(struct task_struct *p, struct rq *rq, int this_cpu,
 	 */
 
 	tsk_cache_hot = task_hot(p, rq->clock_task, sd);
+	if (!tsk_cache_hot)
+		tsk_cache_hot = migrate_degrades_locality(p, cpu_of(rq),
+							  this_cpu);
 	if (!tsk_cache_hot ||
 		sd->nr_balance_failed > sd->cache_nice_tries) {
 #ifdef CONFIG_SCHEDSTATS
@@ -4871,6 +5334,8 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	task_tick_numa(rq, curr);
 }
 
 /*
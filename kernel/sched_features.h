@@ -66,5 +66,31 @@ SCHED_FEAT(NONTASK_POWER, 1)
  */
 SCHED_FEAT(TTWU_QUEUE, 1)
 
+/*
+ * Look for an idle cpu to wake a task on in the last level cache domain
+ * only, first for a whole idle core when the cpus of that domain know
+ * there is one, then for any idle cpu, instead of walking the groups of
+ * every domain sharing the package. Keeps the wakeup cost from growing
+ * with the size of the cache domain.
+ */
+SCHED_FEAT(SIS_LLC, 1)
+
+/*
+ * Bound the idle cpu search by the average idle time of this cpu over
+ * the average cost of a search, so that a busy domain is not scanned
+ * in full on every wakeup only to find nothing. Requires SIS_LLC.
+ */
+SCHED_FEAT(SIS_PROP, 1)
+
 SCHED_FEAT(FORCE_SD_OVERLAP, 0)
 SCHED_FEAT(RT_RUNTIME_SHARE, 1)
+
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Let the load balancer move a task onto the node most of its NUMA
+ * hinting faults were on even if it is cache hot, and resist moving
+ * it off that node as if it were.
+ */
+SCHED_FEAT(NUMA_FAVOUR_HIGHER, 1)
+SCHED_FEAT(NUMA_RESIST_LOWER, 1)
+#endif
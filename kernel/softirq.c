@@ -28,6 +28,9 @@
 #define CREATE_TRACE_POINTS
 #include <trace/events/irq.h>
 
+EXPORT_TRACEPOINT_SYMBOL_GPL(softirq_entry);
+EXPORT_TRACEPOINT_SYMBOL_GPL(softirq_exit);
+
 #include <asm/irq.h>
 /*
    - No shared variables, all the data are CPU local.
@@ -353,6 +356,9 @@ void irq_exit(void)
 	if (idle_cpu(smp_processor_id()) && !in_interrupt() && !need_resched())
 		tick_nohz_stop_sched_tick(0);
 #endif
+	/* Stop or restart the tick of a full dynticks cpu */
+	if (!in_interrupt())
+		tick_nohz_full_irq_exit();
 	preempt_enable_no_resched();
 }
 
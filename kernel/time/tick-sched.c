@@ -11,12 +11,16 @@
  *
  *  Distribute under GPLv2.
  */
+#include <linux/bootmem.h>
 #include <linux/cpu.h>
 #include <linux/err.h>
 #include <linux/hrtimer.h>
 #include <linux/interrupt.h>
+#include <linux/irq_work.h>
 #include <linux/kernel_stat.h>
 #include <linux/percpu.h>
+#include <linux/perf_event.h>
+#include <linux/posix-timers.h>
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
@@ -367,6 +371,15 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (!ts->tick_stopped && delta_jiffies == 1)
 		goto out;
 
+#ifdef CONFIG_NO_HZ_FULL
+	/*
+	 * The timekeeping cpu keeps its tick: the full dynticks cpus rely
+	 * on it for jiffies and for their scheduler accounting.
+	 */
+	if (tick_nohz_full_running && cpu == tick_do_timer_cpu)
+		goto out;
+#endif
+
 	/* Schedule the tick, if we are at least one jiffie off */
 	if ((long)delta_jiffies >= 1) {
 
@@ -578,6 +591,210 @@ void tick_nohz_restart_sched_tick(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Full dynticks: the cpus in tick_nohz_full_mask stop their tick while
+ * they run a single task and nothing else needs it. Whatever needs the
+ * tick again (a second runnable task, a timer, RCU, perf, posix cpu
+ * timers) sends an IPI, and irq_exit() reevaluates the state.
+ */
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running __read_mostly;
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu;
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		pr_warning("NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	cpu = smp_processor_id();
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		pr_warning("NOHZ: Clearing %d from nohz_full range "
+			   "for timekeeping\n", cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+static void nohz_full_kick_work_func(struct irq_work *work)
+{
+	/* Empty, the tick is reevaluated on irq_exit() */
+}
+
+static DEFINE_PER_CPU(struct irq_work, nohz_full_kick_work) = {
+	.func = nohz_full_kick_work_func,
+};
+
+/*
+ * Make a full dynticks cpu reevaluate whether it can keep its tick
+ * stopped. Called with preemption disabled.
+ */
+void __tick_nohz_full_kick_cpu(int cpu)
+{
+	if (cpu != smp_processor_id()) {
+		smp_send_reschedule(cpu);
+		return;
+	}
+
+	if (__get_cpu_var(tick_cpu_sched).full_stopped)
+		irq_work_queue(&__get_cpu_var(nohz_full_kick_work));
+}
+
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+		__tick_nohz_full_kick_cpu(cpu);
+	preempt_enable();
+}
+
+bool tick_nohz_full_tick_stopped(int cpu)
+{
+	return per_cpu(tick_cpu_sched, cpu).full_stopped;
+}
+
+static bool can_stop_full_tick(int cpu)
+{
+	if (cpu == tick_do_timer_cpu)
+		return false;
+
+	if (!sched_can_stop_tick())
+		return false;
+
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return false;
+
+	if (!perf_event_can_stop_tick())
+		return false;
+
+	/* RCU wants a quiescent state or has callbacks queued here */
+	if (rcu_nohz_full_needs_tick(cpu))
+		return false;
+
+	if (printk_needs_cpu(cpu) || arch_needs_cpu(cpu) ||
+	    local_softirq_pending())
+		return false;
+
+	return true;
+}
+
+static void tick_nohz_full_restart(struct tick_sched *ts, ktime_t now)
+{
+#ifndef CONFIG_VIRT_CPU_ACCOUNTING
+	unsigned long ticks;
+
+	/*
+	 * update_process_times() accounts one tick at a time: charge the
+	 * ticks the task ran without it in one go, as user or system time
+	 * depending on where it was when the tick was stopped.
+	 */
+	ticks = jiffies - ts->full_jiffies;
+	if (ticks && ticks < LONG_MAX)
+		account_process_ticks(current, ts->full_user, ticks);
+#endif
+
+	ts->full_stopped = 0;
+	tick_nohz_restart(ts, now);
+}
+
+static void tick_nohz_full_stop_tick(struct tick_sched *ts)
+{
+	unsigned long seq, last_jiffies, delta_jiffies;
+	ktime_t last_update, expires;
+	struct pt_regs *regs;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	delta_jiffies = get_next_timer_interrupt(last_jiffies) - last_jiffies;
+
+	/* A timer is due at the next tick anyway */
+	if ((long)delta_jiffies <= 1) {
+		if (ts->full_stopped)
+			tick_nohz_full_restart(ts, ktime_get());
+		return;
+	}
+
+	if (likely(delta_jiffies < NEXT_TIMER_MAX_DELTA))
+		expires = ktime_add_ns(last_update,
+				       tick_period.tv64 * delta_jiffies);
+	else
+		expires.tv64 = KTIME_MAX;
+
+	/* Skip reprogram of event if its not changed */
+	if (ts->full_stopped &&
+	    ktime_equal(expires, hrtimer_get_expires(&ts->sched_timer)))
+		return;
+
+	if (!ts->full_stopped) {
+		ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
+		ts->full_stopped = 1;
+		ts->full_jiffies = last_jiffies;
+		regs = get_irq_regs();
+		ts->full_user = regs ? user_mode(regs) : 0;
+	}
+
+	if (unlikely(expires.tv64 == KTIME_MAX)) {
+		hrtimer_cancel(&ts->sched_timer);
+		hrtimer_set_expires(&ts->sched_timer, expires);
+		return;
+	}
+
+	/* An expiry in the past is handled by the hrtimer softirq */
+	hrtimer_start(&ts->sched_timer, expires, HRTIMER_MODE_ABS_PINNED);
+}
+
+/*
+ * Called from irq_exit() on a nohz_full cpu, with interrupts disabled:
+ * stop the tick if the current task can run without it, or restart it
+ * if something needs it again.
+ */
+void __tick_nohz_full_irq_exit(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!tick_nohz_full_cpu(cpu) || ts->nohz_mode != NOHZ_MODE_HIGHRES)
+		return;
+
+	/* The idle task has its own nohz path, and schedule() is near */
+	if (idle_cpu(cpu) || need_resched())
+		return;
+
+	if (can_stop_full_tick(cpu))
+		tick_nohz_full_stop_tick(ts);
+	else if (ts->full_stopped)
+		tick_nohz_full_restart(ts, ktime_get());
+}
+
+void __tick_nohz_full_schedule(void)
+{
+	struct tick_sched *ts;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	ts = &__get_cpu_var(tick_cpu_sched);
+	if (ts->full_stopped)
+		tick_nohz_full_restart(ts, ktime_get());
+	local_irq_restore(flags);
+}
+#endif /* CONFIG_NO_HZ_FULL */
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -753,15 +970,21 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * concurrency: This happens only when the cpu in charge went
 	 * into a long sleep. If two cpus happen to assign themself to
 	 * this duty, then the jiffies update is still serialized by
-	 * xtime_lock.
+	 * xtime_lock. Full dynticks cpus never take it.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
 	/* Check, if the jiffies need an update */
-	if (tick_do_timer_cpu == cpu)
+	if (tick_do_timer_cpu == cpu) {
 		tick_do_update_jiffies64(now);
+#ifdef CONFIG_NO_HZ_FULL
+		if (tick_nohz_full_running)
+			sched_tick_remote();
+#endif
+	}
 
 	/*
 	 * Do not call, when we are not in irq context and have
@@ -780,6 +1003,11 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
 		}
+#ifdef CONFIG_NO_HZ_FULL
+		/* Same for the ticks of a task accounted on restart */
+		if (ts->full_stopped)
+			ts->full_jiffies++;
+#endif
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
 	}
@@ -55,22 +55,59 @@ u64 jiffies_64 __cacheline_aligned_in_smp = INITIAL_JIFFIES;
 EXPORT_SYMBOL(jiffies_64);
 
 /*
- * per-CPU timer vector definitions:
+ * per-CPU timer wheel definitions:
+ *
+ * The wheel has LVL_DEPTH levels of LVL_SIZE buckets. The buckets of
+ * level n are LVL_GRAN(n) jiffies apart, and a timer is queued once, in
+ * the level whose granularity is about 1/8 of its timeout, rounded up
+ * to the bucket boundary. Timers are never cascaded to a finer level:
+ * they expire up to LVL_GRAN(n) - 1 jiffies late instead, which is fine
+ * for the timeouts that make up most of the timers (networking, block
+ * I/O) since these are usually deleted before they expire anyway.
+ *
+ * HZ 1000:
+ * Level Offset  Granularity            Range
+ *  0      0         1 ms                0 ms -         63 ms
+ *  1     64         8 ms               64 ms -        511 ms
+ *  2    128        64 ms              512 ms -       4095 ms (512ms - ~4s)
+ *  3    192       512 ms             4096 ms -      32767 ms (~4s - ~32s)
+ *  4    256      4096 ms (~4s)      32768 ms -     262143 ms (~32s - ~4m)
+ *  5    320     32768 ms (~32s)    262144 ms -    2097151 ms (~4m - ~34m)
+ *  6    384    262144 ms (~4m)    2097152 ms -   16777215 ms (~34m - ~4h)
+ *  7    448   2097152 ms (~34m)  16777216 ms -  134217727 ms (~4h - ~1d)
+ *  8    512  16777216 ms (~4h)  134217728 ms - 1073741822 ms (~1d - ~12d)
+ *
+ * Timeouts beyond the last level are capped, and the timer is requeued
+ * when the capped bucket expires.
  */
-#define TVN_BITS (CONFIG_BASE_SMALL ? 4 : 6)
-#define TVR_BITS (CONFIG_BASE_SMALL ? 6 : 8)
-#define TVN_SIZE (1 << TVN_BITS)
-#define TVR_SIZE (1 << TVR_BITS)
-#define TVN_MASK (TVN_SIZE - 1)
-#define TVR_MASK (TVR_SIZE - 1)
-#define MAX_TVAL ((unsigned long)((1ULL << (TVR_BITS + 4*TVN_BITS)) - 1))
+#define LVL_CLK_SHIFT	3
+#define LVL_CLK_DIV	(1UL << LVL_CLK_SHIFT)
+#define LVL_CLK_MASK	(LVL_CLK_DIV - 1)
+#define LVL_SHIFT(n)	((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n)	(1UL << LVL_SHIFT(n))
+
+/* The first jiffy delta that goes to level n */
+#define LVL_START(n)	((LVL_SIZE - 1) << (((n) - 1) * LVL_CLK_SHIFT))
+
+#define LVL_BITS	6
+#define LVL_SIZE	(1UL << LVL_BITS)
+#define LVL_MASK	(LVL_SIZE - 1)
+#define LVL_OFFS(n)	((n) * LVL_SIZE)
+
+#if HZ > 100
+# define LVL_DEPTH	9
+#else
+# define LVL_DEPTH	8
+#endif
 
-struct tvec {
-	struct list_head vec[TVN_SIZE];
-};
+#define WHEEL_TIMEOUT_CUTOFF	(LVL_START(LVL_DEPTH))
+#define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
+#define WHEEL_SIZE		(LVL_SIZE * LVL_DEPTH)
 
-struct tvec_root {
-	struct list_head vec[TVR_SIZE];
+struct tvec {
+	/* A set bit may belong to a bucket which has been emptied since */
+	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
+	struct list_head vec[WHEEL_SIZE];
 };
 
 struct tvec_base {
@@ -78,11 +115,11 @@ struct tvec_base {
 	struct timer_list *running_timer;
 	unsigned long timer_jiffies;
 	unsigned long next_timer;
-	struct tvec_root tv1;
-	struct tvec tv2;
-	struct tvec tv3;
-	struct tvec tv4;
-	struct tvec tv5;
+	struct tvec tv;
+#ifdef CONFIG_NO_HZ
+	/* Deferrable timers, which must not wake up an idle cpu */
+	struct tvec tv_def;
+#endif
 } ____cacheline_aligned;
 
 struct tvec_base boot_tvec_bases;
@@ -112,6 +149,16 @@ timer_set_base(struct timer_list *timer, struct tvec_base *new_base)
 				      tbase_get_deferrable(timer->base));
 }
 
+static inline struct tvec *timer_wheel(struct tvec_base *base,
+				       struct timer_list *timer)
+{
+#ifdef CONFIG_NO_HZ
+	if (tbase_get_deferrable(timer->base))
+		return &base->tv_def;
+#endif
+	return &base->tv;
+}
+
 static unsigned long round_jiffies_common(unsigned long j, int cpu,
 		bool force_up)
 {
@@ -333,49 +380,164 @@ void set_timer_slack(struct timer_list *timer, int slack_hz)
 }
 EXPORT_SYMBOL_GPL(set_timer_slack);
 
-static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
-{
-	unsigned long expires = timer->expires;
-	unsigned long idx = expires - base->timer_jiffies;
-	struct list_head *vec;
-
-	if (idx < TVR_SIZE) {
-		int i = expires & TVR_MASK;
-		vec = base->tv1.vec + i;
-	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
-		int i = (expires >> TVR_BITS) & TVN_MASK;
-		vec = base->tv2.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
-		vec = base->tv3.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv4.vec + i;
-	} else if ((signed long) idx < 0) {
-		/*
-		 * Can happen if you add a timer with expires == jiffies,
-		 * or you set a timer to go off in the past
-		 */
-		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
-	} else {
-		int i;
-		/* If the timeout is larger than MAX_TVAL (on 64-bit
-		 * architectures or with CONFIG_BASE_SMALL=1) then we
-		 * use the maximum timeout.
-		 */
-		if (idx > MAX_TVAL) {
-			idx = MAX_TVAL;
-			expires = idx + base->timer_jiffies;
-		}
-		i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv5.vec + i;
+/*
+ * Bucket of level @lvl for @expires. Above level 0 the expiry time is
+ * rounded up to the granularity of the level, so that the timer never
+ * fires early.
+ */
+static inline unsigned int calc_index(unsigned long expires, unsigned int lvl,
+				      unsigned long *bucket_expiry)
+{
+	expires = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+	*bucket_expiry = expires << LVL_SHIFT(lvl);
+	return LVL_OFFS(lvl) + (expires & LVL_MASK);
+}
+
+static unsigned int calc_wheel_index(unsigned long expires, unsigned long clk,
+				     unsigned long *bucket_expiry)
+{
+	unsigned long delta = expires - clk;
+	unsigned int lvl;
+
+	/*
+	 * Can happen if you add a timer with expires == jiffies,
+	 * or you set a timer to go off in the past
+	 */
+	if ((long)delta < 0) {
+		*bucket_expiry = clk;
+		return clk & LVL_MASK;
 	}
+
+	/* Cap the timeout, the timer is requeued when the bucket expires */
+	if (delta >= WHEEL_TIMEOUT_CUTOFF) {
+		expires = clk + WHEEL_TIMEOUT_MAX;
+		delta = WHEEL_TIMEOUT_MAX;
+	}
+
+	for (lvl = 0; lvl < LVL_DEPTH - 1; lvl++) {
+		if (delta < LVL_START(lvl + 1))
+			break;
+	}
+	return calc_index(expires, lvl, bucket_expiry);
+}
+
+/*
+ * Queue @timer in its wheel. Returns true if its bucket expires before
+ * any other non-deferrable timer of @base, in which case a cpu running
+ * without tick has to reevaluate its next event.
+ */
+static bool internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+{
+	struct tvec *tv = timer_wheel(base, timer);
+	unsigned long bucket_expiry;
+	unsigned int idx;
+
+	idx = calc_wheel_index(timer->expires, base->timer_jiffies,
+			       &bucket_expiry);
 	/*
 	 * Timers are FIFO:
 	 */
-	list_add_tail(&timer->entry, vec);
+	list_add_tail(&timer->entry, tv->vec + idx);
+	__set_bit(idx, tv->pending_map);
+
+	if (tbase_get_deferrable(timer->base) ||
+	    !time_before(bucket_expiry, base->next_timer))
+		return false;
+
+	base->next_timer = bucket_expiry;
+	return true;
+}
+
+#ifdef CONFIG_NO_HZ
+/*
+ * Distance from @clk to the next non-empty bucket of the level starting
+ * at @offset, or -1 if the level is empty. Bits of buckets which have
+ * been emptied by del_timer() are cleared on the way.
+ */
+static int next_pending_bucket(struct tvec *tv, unsigned int offset,
+			       unsigned int clk)
+{
+	unsigned int pos, start = offset + clk;
+	unsigned int end = offset + LVL_SIZE;
+
+	for (;;) {
+		pos = find_next_bit(tv->pending_map, end, start);
+		if (pos >= end) {
+			pos = find_next_bit(tv->pending_map, start, offset);
+			if (pos >= start)
+				return -1;
+		}
+		if (!list_empty(tv->vec + pos))
+			break;
+		__clear_bit(pos, tv->pending_map);
+	}
+
+	return pos >= start ? pos - start : pos + LVL_SIZE - start;
+}
+
+/*
+ * Find the expiry time of the first non-empty bucket of @tv. The
+ * search is done level by level, starting from the bucket that comes
+ * next at each level, so it does not depend on the number of timers.
+ */
+static unsigned long __next_timer_interrupt(struct tvec_base *base,
+					    struct tvec *tv)
+{
+	unsigned long clk, next, adj;
+	unsigned int lvl, offset = 0;
+
+	next = base->timer_jiffies + NEXT_TIMER_MAX_DELTA;
+	clk = base->timer_jiffies;
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++, offset += LVL_SIZE) {
+		int pos = next_pending_bucket(tv, offset, clk & LVL_MASK);
+
+		if (pos >= 0) {
+			unsigned long tmp = clk + (unsigned long)pos;
+
+			tmp <<= LVL_SHIFT(lvl);
+			if (time_before(tmp, next))
+				next = tmp;
+		}
+		/*
+		 * Clock of the next level: if the lower bits of this one
+		 * are not zero, the bucket of the next level at the same
+		 * index has been processed already, and the next one to
+		 * come is the following one.
+		 */
+		adj = clk & LVL_CLK_MASK ? 1 : 0;
+		clk >>= LVL_CLK_SHIFT;
+		clk += adj;
+	}
+	return next;
 }
 
+/*
+ * While the tick is stopped, timer_jiffies lags behind jiffies. Move it
+ * up to the first non-empty bucket, or to jiffies, so that new timers
+ * get the granularity of their actual timeout, and __run_timers() does
+ * not have to walk every jiffy of the idle period.
+ */
+static void forward_timer_base(struct tvec_base *base)
+{
+	unsigned long jnow = ACCESS_ONCE(jiffies);
+	unsigned long next, next_def;
+
+	if ((long)(jnow - base->timer_jiffies) < 2)
+		return;
+
+	/* The buckets of deferrable timers must not be skipped either */
+	next = __next_timer_interrupt(base, &base->tv);
+	next_def = __next_timer_interrupt(base, &base->tv_def);
+	if (time_before(next_def, next))
+		next = next_def;
+	if (time_after(next, jnow))
+		next = jnow;
+	base->timer_jiffies = next;
+}
+#else
+static inline void forward_timer_base(struct tvec_base *base) { }
+#endif
+
 #ifdef CONFIG_TIMER_STATS
 void __timer_stats_timer_set_start_info(struct timer_list *timer, void *addr)
 {
@@ -631,7 +793,7 @@ static inline void detach_timer(struct timer_list *timer,
  * locked, and the base itself is locked too.
  *
  * So __run_timers/migrate_timers can safely modify all timers which could
- * be found on ->tvX lists.
+ * be found in the buckets of the wheels.
  *
  * When the timer's base is locked, and the timer removed from list, it is
  * possible to set timer->base = NULL and drop the lock: the timer remains
@@ -672,9 +834,6 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 
 	if (timer_pending(timer)) {
 		detach_timer(timer, 0);
-		if (timer->expires == base->next_timer &&
-		    !tbase_get_deferrable(timer->base))
-			base->next_timer = base->timer_jiffies;
 		ret = 1;
 	} else {
 		if (pending_only)
@@ -710,10 +869,10 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	}
 
 	timer->expires = expires;
-	if (time_before(timer->expires, base->next_timer) &&
-	    !tbase_get_deferrable(timer->base))
-		base->next_timer = timer->expires;
-	internal_add_timer(base, timer);
+	forward_timer_base(base);
+	/* A cpu running without tick has to see the new timer */
+	if (internal_add_timer(base, timer) && base == new_base)
+		tick_nohz_full_kick_cpu(cpu);
 
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -872,9 +1031,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
 	debug_activate(timer, timer->expires);
-	if (time_before(timer->expires, base->next_timer) &&
-	    !tbase_get_deferrable(timer->base))
-		base->next_timer = timer->expires;
+	forward_timer_base(base);
 	internal_add_timer(base, timer);
 	/*
 	 * Check whether the other CPU is idle and needs to be
@@ -885,6 +1042,8 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 * the timer wheel.
 	 */
 	wake_up_idle_cpu(cpu);
+	/* Same for a full dynticks cpu running with its tick stopped */
+	tick_nohz_full_kick_cpu(cpu);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
@@ -911,9 +1070,6 @@ int del_timer(struct timer_list *timer)
 		base = lock_timer_base(timer, &flags);
 		if (timer_pending(timer)) {
 			detach_timer(timer, 1);
-			if (timer->expires == base->next_timer &&
-			    !tbase_get_deferrable(timer->base))
-				base->next_timer = base->timer_jiffies;
 			ret = 1;
 		}
 		spin_unlock_irqrestore(&base->lock, flags);
@@ -945,9 +1101,6 @@ int try_to_del_timer_sync(struct timer_list *timer)
 	ret = 0;
 	if (timer_pending(timer)) {
 		detach_timer(timer, 1);
-		if (timer->expires == base->next_timer &&
-		    !tbase_get_deferrable(timer->base))
-			base->next_timer = base->timer_jiffies;
 		ret = 1;
 	}
 out:
@@ -1023,24 +1176,25 @@ int del_timer_sync(struct timer_list *timer)
 EXPORT_SYMBOL(del_timer_sync);
 #endif
 
-static int cascade(struct tvec_base *base, struct tvec *tv, int index)
-{
-	/* cascade all the timers from tv up one level */
-	struct timer_list *timer, *tmp;
-	struct list_head tv_list;
-
-	list_replace_init(tv->vec + index, &tv_list);
-
-	/*
-	 * We are removing _all_ timers from the list, so we
-	 * don't have to detach them individually.
-	 */
-	list_for_each_entry_safe(timer, tmp, &tv_list, entry) {
-		BUG_ON(tbase_get_base(timer->base) != base);
-		internal_add_timer(base, timer);
+/*
+ * Move the timers of every bucket that expires at timer_jiffies to @head:
+ * the one of level 0, and the one of each upper level for as long as
+ * timer_jiffies is a multiple of its granularity.
+ */
+static void collect_expired_timers(struct tvec_base *base, struct tvec *tv,
+				   struct list_head *head)
+{
+	unsigned long clk = base->timer_jiffies;
+	unsigned int lvl, idx;
+
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++) {
+		idx = (clk & LVL_MASK) + LVL_OFFS(lvl);
+		if (__test_and_clear_bit(idx, tv->pending_map))
+			list_splice_tail_init(tv->vec + idx, head);
+		if (clk & LVL_CLK_MASK)
+			break;
+		clk >>= LVL_CLK_SHIFT;
 	}
-
-	return index;
 }
 
 static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
@@ -1084,14 +1238,12 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 	}
 }
 
-#define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
-
 /**
  * __run_timers - run all expired timers (if any) on this CPU.
  * @base: the timer vector to be processed.
  *
- * This function cascades all vectors and executes all expired timer
- * vectors.
+ * This function collects the expired buckets of all levels and
+ * executes their timers.
  */
 static inline void __run_timers(struct tvec_base *base)
 {
@@ -1101,23 +1253,30 @@ static inline void __run_timers(struct tvec_base *base)
 	while (time_after_eq(jiffies, base->timer_jiffies)) {
 		struct list_head work_list;
 		struct list_head *head = &work_list;
-		int index = base->timer_jiffies & TVR_MASK;
+		unsigned long clk;
 
-		/*
-		 * Cascade timers:
-		 */
-		if (!index &&
-			(!cascade(base, &base->tv2, INDEX(0))) &&
-				(!cascade(base, &base->tv3, INDEX(1))) &&
-					!cascade(base, &base->tv4, INDEX(2)))
-			cascade(base, &base->tv5, INDEX(3));
+		forward_timer_base(base);
+		clk = base->timer_jiffies;
+
+		INIT_LIST_HEAD(head);
+		collect_expired_timers(base, &base->tv, head);
+#ifdef CONFIG_NO_HZ
+		collect_expired_timers(base, &base->tv_def, head);
+#endif
 		++base->timer_jiffies;
-		list_replace_init(base->tv1.vec + index, &work_list);
 		while (!list_empty(head)) {
 			void (*fn)(unsigned long);
 			unsigned long data;
 
 			timer = list_first_entry(head, struct timer_list,entry);
+
+			/* A capped timeout which is not due yet */
+			if (time_after(timer->expires, clk)) {
+				list_del(&timer->entry);
+				internal_add_timer(base, timer);
+				continue;
+			}
+
 			fn = timer->function;
 			data = timer->data;
 
@@ -1136,81 +1295,6 @@ static inline void __run_timers(struct tvec_base *base)
 }
 
 #ifdef CONFIG_NO_HZ
-/*
- * Find out when the next timer event is due to happen. This
- * is used on S/390 to stop all activity when a CPU is idle.
- * This function needs to be called with interrupts disabled.
- */
-static unsigned long __next_timer_interrupt(struct tvec_base *base)
-{
-	unsigned long timer_jiffies = base->timer_jiffies;
-	unsigned long expires = timer_jiffies + NEXT_TIMER_MAX_DELTA;
-	int index, slot, array, found = 0;
-	struct timer_list *nte;
-	struct tvec *varray[4];
-
-	/* Look for timer events in tv1. */
-	index = slot = timer_jiffies & TVR_MASK;
-	do {
-		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
-			if (tbase_get_deferrable(nte->base))
-				continue;
-
-			found = 1;
-			expires = nte->expires;
-			/* Look at the cascade bucket(s)? */
-			if (!index || slot < index)
-				goto cascade;
-			return expires;
-		}
-		slot = (slot + 1) & TVR_MASK;
-	} while (slot != index);
-
-cascade:
-	/* Calculate the next cascade event */
-	if (index)
-		timer_jiffies += TVR_SIZE - index;
-	timer_jiffies >>= TVR_BITS;
-
-	/* Check tv2-tv5. */
-	varray[0] = &base->tv2;
-	varray[1] = &base->tv3;
-	varray[2] = &base->tv4;
-	varray[3] = &base->tv5;
-
-	for (array = 0; array < 4; array++) {
-		struct tvec *varp = varray[array];
-
-		index = slot = timer_jiffies & TVN_MASK;
-		do {
-			list_for_each_entry(nte, varp->vec + slot, entry) {
-				if (tbase_get_deferrable(nte->base))
-					continue;
-
-				found = 1;
-				if (time_before(nte->expires, expires))
-					expires = nte->expires;
-			}
-			/*
-			 * Do we still search for the first timer or are
-			 * we looking up the cascade buckets ?
-			 */
-			if (found) {
-				/* Look at the cascade bucket(s)? */
-				if (!index || slot < index)
-					break;
-				return expires;
-			}
-			slot = (slot + 1) & TVN_MASK;
-		} while (slot != index);
-
-		if (index)
-			timer_jiffies += TVN_SIZE - index;
-		timer_jiffies >>= TVN_BITS;
-	}
-	return expires;
-}
-
 /*
  * Check, if the next hrtimer event is before the next timer wheel
  * event:
@@ -1271,8 +1355,7 @@ unsigned long get_next_timer_interrupt(unsigned long now)
 	if (cpu_is_offline(smp_processor_id()))
 		return now + NEXT_TIMER_MAX_DELTA;
 	spin_lock(&base->lock);
-	if (time_before_eq(base->next_timer, base->timer_jiffies))
-		base->next_timer = __next_timer_interrupt(base);
+	base->next_timer = __next_timer_interrupt(base, &base->tv);
 	expires = base->next_timer;
 	spin_unlock(&base->lock);
 
@@ -1639,17 +1722,19 @@ static int __cpuinit init_timers_cpu(int cpu)
 	}
 
 
-	for (j = 0; j < TVN_SIZE; j++) {
-		INIT_LIST_HEAD(base->tv5.vec + j);
-		INIT_LIST_HEAD(base->tv4.vec + j);
-		INIT_LIST_HEAD(base->tv3.vec + j);
-		INIT_LIST_HEAD(base->tv2.vec + j);
+	for (j = 0; j < WHEEL_SIZE; j++) {
+		INIT_LIST_HEAD(base->tv.vec + j);
+#ifdef CONFIG_NO_HZ
+		INIT_LIST_HEAD(base->tv_def.vec + j);
+#endif
 	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
+	bitmap_zero(base->tv.pending_map, WHEEL_SIZE);
+#ifdef CONFIG_NO_HZ
+	bitmap_zero(base->tv_def.pending_map, WHEEL_SIZE);
+#endif
 
 	base->timer_jiffies = jiffies;
-	base->next_timer = base->timer_jiffies;
+	base->next_timer = base->timer_jiffies + NEXT_TIMER_MAX_DELTA;
 	return 0;
 }
 
@@ -1662,9 +1747,6 @@ static void migrate_timer_list(struct tvec_base *new_base, struct list_head *hea
 		timer = list_first_entry(head, struct timer_list, entry);
 		detach_timer(timer, 0);
 		timer_set_base(timer, new_base);
-		if (time_before(timer->expires, new_base->next_timer) &&
-		    !tbase_get_deferrable(timer->base))
-			new_base->next_timer = timer->expires;
 		internal_add_timer(new_base, timer);
 	}
 }
@@ -1687,13 +1769,12 @@ static void __cpuinit migrate_timers(int cpu)
 
 	BUG_ON(old_base->running_timer);
 
-	for (i = 0; i < TVR_SIZE; i++)
-		migrate_timer_list(new_base, old_base->tv1.vec + i);
-	for (i = 0; i < TVN_SIZE; i++) {
-		migrate_timer_list(new_base, old_base->tv2.vec + i);
-		migrate_timer_list(new_base, old_base->tv3.vec + i);
-		migrate_timer_list(new_base, old_base->tv4.vec + i);
-		migrate_timer_list(new_base, old_base->tv5.vec + i);
+	forward_timer_base(new_base);
+	for (i = 0; i < WHEEL_SIZE; i++) {
+		migrate_timer_list(new_base, old_base->tv.vec + i);
+#ifdef CONFIG_NO_HZ
+		migrate_timer_list(new_base, old_base->tv_def.vec + i);
+#endif
 	}
 
 	spin_unlock(&old_base->lock);
@@ -0,0 +1,332 @@
+/*
+ * Timer wheel churn test
+ *
+ * Models the timeout timers of a busy network server: every one of the
+ * nthreads kernel threads is bound to its own CPU and owns nr_timers
+ * timers, the way every TCP socket owns a retransmit timer, and keeps
+ * re-arming random ones with mod_timer() to between min_timeout_ms and
+ * max_timeout_ms from now.  Most timers are thus moved long before they
+ * would expire, and a few of them do expire.  A probe timer re-armed on
+ * every tick measures how long the timer softirq gets held up by the
+ * rest of the wheel.
+ *
+ * The churn goes on until the module is removed.  Every stat_interval
+ * seconds, and at rmmod, the mod_timer() calls per second and the
+ * timers that expired since the previous report are printed, along
+ * with how late expired timers ran and the largest probe gap so far.
+ *
+ * A timer that runs before its expiry time is a bug of the wheel; if
+ * any did, the test ends with FAILURE.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/timer.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+#include <linux/cpu.h>
+
+static int nthreads;
+module_param(nthreads, int, 0444);
+MODULE_PARM_DESC(nthreads, "Number of churn threads (default: online CPUs)");
+
+static int nr_timers = 10000;
+module_param(nr_timers, int, 0444);
+MODULE_PARM_DESC(nr_timers, "Number of timers owned by each thread");
+
+static int min_timeout_ms = 10;
+module_param(min_timeout_ms, int, 0444);
+MODULE_PARM_DESC(min_timeout_ms, "Shortest timeout of a timer");
+
+static int max_timeout_ms = 30000;
+module_param(max_timeout_ms, int, 0444);
+MODULE_PARM_DESC(max_timeout_ms, "Longest timeout of a timer");
+
+static int stat_interval = 60;
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval,
+		 "Number of seconds between stats printk()s, 0 for only at rmmod");
+
+struct churn_thread;
+
+struct churn_timer {
+	struct timer_list timer;
+	struct churn_thread *owner;
+};
+
+struct churn_thread {
+	struct task_struct *task;
+	struct churn_timer *timers;
+	unsigned long mods;
+	/* Updated from the timer callbacks */
+	unsigned long fired;
+	unsigned long early;
+	unsigned long late_sum;
+	unsigned long late_max;
+} ____cacheline_aligned_in_smp;
+
+/* Sums over all threads as of the last stats printk */
+static struct {
+	unsigned long mods;
+	unsigned long fired;
+	unsigned long late_sum;
+	ktime_t time;
+} reported;
+
+static struct churn_thread *churn_threads;
+static struct task_struct *stats_task;
+
+/* Probe timer, re-armed on every tick */
+static struct timer_list probe_timer;
+static bool probe_stop;
+static ktime_t probe_last;
+static s64 probe_max_gap_ns;
+
+static void churn_timer_fn(unsigned long data)
+{
+	struct churn_timer *ct = (struct churn_timer *)data;
+	struct churn_thread *t = ct->owner;
+	unsigned long late = jiffies - ct->timer.expires;
+
+	if ((long)late < 0) {
+		t->early++;
+		return;
+	}
+	t->fired++;
+	t->late_sum += late;
+	t->late_max = max(t->late_max, late);
+}
+
+static void probe_timer_fn(unsigned long data)
+{
+	ktime_t now = ktime_get();
+	s64 gap = ktime_to_ns(ktime_sub(now, probe_last));
+
+	if (gap > probe_max_gap_ns)
+		probe_max_gap_ns = gap;
+	probe_last = now;
+	if (!ACCESS_ONCE(probe_stop))
+		mod_timer_pinned(&probe_timer, jiffies + 1);
+}
+
+static unsigned long churn_timeout(void)
+{
+	unsigned int span = max_timeout_ms - min_timeout_ms + 1;
+
+	return msecs_to_jiffies(min_timeout_ms + random32() % span);
+}
+
+static int timer_churn_thread(void *arg)
+{
+	struct churn_thread *t = arg;
+	int i;
+
+	do {
+		i = random32() % nr_timers;
+		mod_timer(&t->timers[i].timer, jiffies + churn_timeout());
+		if (!(++t->mods & 63))
+			cond_resched();
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+/*
+ * Print the churn since the last call.  Only ever called by the stats
+ * kthread, or at rmmod once that has been stopped.
+ */
+static void timer_churn_stats_print(void)
+{
+	unsigned long mods = 0, fired = 0, late_sum = 0, late_max = 0;
+	ktime_t now = ktime_get();
+	s64 us = max_t(s64, ktime_us_delta(now, reported.time), 1);
+	int i;
+
+	for (i = 0; i < nthreads; i++) {
+		struct churn_thread *t = &churn_threads[i];
+
+		mods += ACCESS_ONCE(t->mods);
+		fired += ACCESS_ONCE(t->fired);
+		late_sum += ACCESS_ONCE(t->late_sum);
+		late_max = max(late_max, ACCESS_ONCE(t->late_max));
+	}
+
+	printk(KERN_ALERT "timerchurn: %d threads: %llu mod_timer/s, "
+	       "%lu expired, late avg %u max %u ms, probe gap max %lld us\n",
+	       nthreads,
+	       div64_u64((u64)(mods - reported.mods) * USEC_PER_SEC, us),
+	       fired - reported.fired,
+	       jiffies_to_msecs(fired != reported.fired ?
+				(late_sum - reported.late_sum) /
+				(fired - reported.fired) : 0),
+	       jiffies_to_msecs(late_max),
+	       ACCESS_ONCE(probe_max_gap_ns) / NSEC_PER_USEC);
+
+	reported.mods = mods;
+	reported.fired = fired;
+	reported.late_sum = late_sum;
+	reported.time = now;
+}
+
+static int timer_churn_stats(void *arg)
+{
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		timer_churn_stats_print();
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+static void timer_churn_print_module_parms(const char *tag)
+{
+	printk(KERN_ALERT "timerchurn: nthreads=%d nr_timers=%d "
+	       "min_timeout_ms=%d max_timeout_ms=%d stat_interval=%d HZ=%d: "
+	       "%s\n", nthreads, nr_timers, min_timeout_ms, max_timeout_ms,
+	       stat_interval, HZ, tag);
+}
+
+/* Stop all kthreads and timers, leaving the counters for a last print */
+static void timer_churn_stop(void)
+{
+	int i, j;
+
+	if (stats_task)
+		kthread_stop(stats_task);
+	stats_task = NULL;
+
+	for (i = 0; i < nthreads; i++) {
+		if (churn_threads[i].task)
+			kthread_stop(churn_threads[i].task);
+		churn_threads[i].task = NULL;
+	}
+
+	ACCESS_ONCE(probe_stop) = true;
+	del_timer_sync(&probe_timer);
+
+	for (i = 0; i < nthreads; i++) {
+		if (!churn_threads[i].timers)
+			continue;
+		for (j = 0; j < nr_timers; j++)
+			del_timer_sync(&churn_threads[i].timers[j].timer);
+	}
+}
+
+static void timer_churn_free(void)
+{
+	int i;
+
+	for (i = 0; i < nthreads; i++)
+		vfree(churn_threads[i].timers);
+	kfree(churn_threads);
+}
+
+static void __exit timer_churn_cleanup(void)
+{
+	unsigned long early = 0;
+	int i;
+
+	timer_churn_stop();
+	timer_churn_stats_print();  /* -After- the stats thread is stopped! */
+
+	for (i = 0; i < nthreads; i++)
+		early += churn_threads[i].early;
+	timer_churn_free();
+
+	if (early) {
+		printk(KERN_ALERT "timerchurn: %lu timers ran early\n", early);
+		timer_churn_print_module_parms("End of test: FAILURE");
+	} else
+		timer_churn_print_module_parms("End of test: SUCCESS");
+}
+module_exit(timer_churn_cleanup);
+
+static int alloc_timers(struct churn_thread *t)
+{
+	int i;
+
+	t->timers = vzalloc(nr_timers * sizeof(*t->timers));
+	if (!t->timers)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_timers; i++) {
+		t->timers[i].owner = t;
+		setup_timer(&t->timers[i].timer, churn_timer_fn,
+			    (unsigned long)&t->timers[i]);
+	}
+	return 0;
+}
+
+static int __init timer_churn_init(void)
+{
+	struct churn_thread *t;
+	int i, cpu, err = 0;
+
+	if (nr_timers <= 0 || min_timeout_ms < 0 ||
+	    max_timeout_ms < min_timeout_ms || stat_interval < 0)
+		return -EINVAL;
+
+	setup_timer(&probe_timer, probe_timer_fn, 0);
+
+	get_online_cpus();
+	if (nthreads <= 0 || nthreads > num_online_cpus())
+		nthreads = num_online_cpus();
+
+	churn_threads = kcalloc(nthreads, sizeof(*churn_threads), GFP_KERNEL);
+	if (!churn_threads) {
+		put_online_cpus();
+		return -ENOMEM;
+	}
+	for (i = 0; i < nthreads; i++) {
+		err = alloc_timers(&churn_threads[i]);
+		if (err)
+			goto out;
+	}
+
+	timer_churn_print_module_parms("Start of test");
+	reported.time = ktime_get();
+
+	probe_last = ktime_get();
+	mod_timer_pinned(&probe_timer, jiffies + 1);
+
+	i = 0;
+	for_each_online_cpu(cpu) {
+		if (i == nthreads)
+			break;
+		t = &churn_threads[i++];
+		t->task = kthread_create(timer_churn_thread, t,
+					 "timerchurn/%d", cpu);
+		if (IS_ERR(t->task)) {
+			err = PTR_ERR(t->task);
+			t->task = NULL;
+			goto out;
+		}
+		kthread_bind(t->task, cpu);
+		wake_up_process(t->task);
+	}
+
+	if (stat_interval > 0) {
+		stats_task = kthread_run(timer_churn_stats, NULL,
+					 "timerchurn_stats");
+		if (IS_ERR(stats_task)) {
+			err = PTR_ERR(stats_task);
+			stats_task = NULL;
+		}
+	}
+
+out:
+	put_online_cpus();
+	if (err) {
+		timer_churn_stop();
+		timer_churn_free();
+	}
+	return err;
+}
+module_init(timer_churn_init);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,357 @@
+/*
+ * Stress and latency test for the vmalloc allocator
+ *
+ * Starts nthreads kernel threads, each bound to its own CPU, which go
+ * through the vmalloc patterns selected by run_test_mask over and over
+ * until the module is removed, doing nr_iterations alloc/free pairs of
+ * one pattern before moving to the next.  The patterns cover fixed and
+ * random sized vmalloc(), vmalloc() next to many live areas, and the
+ * per-cpu vmap blocks behind vm_map_ram(), so that the contention on
+ * kernel virtual address space between many CPUs shows up.
+ *
+ * Every stat_interval seconds, and at rmmod, the average latency of one
+ * alloc/free pair and the pairs per second since the previous report
+ * are printed for every pattern.  A failed allocation fails the test.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/cpu.h>
+
+static int nthreads;
+module_param(nthreads, int, 0444);
+MODULE_PARM_DESC(nthreads, "Number of test threads (default: online CPUs)");
+
+static int nr_iterations = 1000;
+module_param(nr_iterations, int, 0444);
+MODULE_PARM_DESC(nr_iterations,
+		 "Alloc/free pairs of a pattern before moving to the next");
+
+static int run_test_mask = ~0;
+module_param(run_test_mask, int, 0444);
+MODULE_PARM_DESC(run_test_mask, "Bitmask of tests to run (default: all)");
+
+static int stat_interval = 60;
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval,
+		 "Number of seconds between stats printk()s, 0 for only at rmmod");
+
+#define MAP_RAM_PAGES		8
+#define BUSY_LIST_AREAS		500
+
+static int fix_size_alloc_test(void)
+{
+	void *ptr;
+	int i;
+
+	for (i = 0; i < nr_iterations; i++) {
+		ptr = vmalloc(3 * PAGE_SIZE);
+		if (!ptr)
+			return -ENOMEM;
+		*((u8 *)ptr) = 0;
+		vfree(ptr);
+	}
+
+	return 0;
+}
+
+static int random_size_alloc_test(void)
+{
+	unsigned int n;
+	void *ptr;
+	int i;
+
+	for (i = 0; i < nr_iterations; i++) {
+		n = (random32() % 16) + 1;
+		ptr = vmalloc(n * PAGE_SIZE);
+		if (!ptr)
+			return -ENOMEM;
+		vfree(ptr);
+	}
+
+	return 0;
+}
+
+/* Churn single pages while many other areas are allocated */
+static int long_busy_list_alloc_test(void)
+{
+	void **busy;
+	void *ptr;
+	int i, ret = 0;
+
+	busy = kcalloc(BUSY_LIST_AREAS, sizeof(void *), GFP_KERNEL);
+	if (!busy)
+		return -ENOMEM;
+
+	for (i = 0; i < BUSY_LIST_AREAS; i++) {
+		busy[i] = vmalloc(PAGE_SIZE);
+		if (!busy[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < nr_iterations; i++) {
+		ptr = vmalloc(PAGE_SIZE);
+		if (!ptr) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		vfree(ptr);
+	}
+
+out:
+	for (i = 0; i < BUSY_LIST_AREAS; i++)
+		vfree(busy[i]);
+	kfree(busy);
+	return ret;
+}
+
+/* Exercise the per cpu vmap block allocator behind vm_map_ram */
+static int map_ram_test(void)
+{
+	struct page *pages[MAP_RAM_PAGES] = { NULL };
+	void *ptr;
+	int i, ret = 0;
+
+	for (i = 0; i < MAP_RAM_PAGES; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < nr_iterations; i++) {
+		ptr = vm_map_ram(pages, MAP_RAM_PAGES, -1, PAGE_KERNEL);
+		if (!ptr) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		vm_unmap_ram(ptr, MAP_RAM_PAGES);
+	}
+
+out:
+	for (i = 0; i < MAP_RAM_PAGES; i++)
+		if (pages[i])
+			__free_page(pages[i]);
+	return ret;
+}
+
+struct test_case_desc {
+	const char *name;
+	int (*fn)(void);
+};
+
+static struct test_case_desc test_cases[] = {
+	{ "fix_size_alloc_test", fix_size_alloc_test },
+	{ "random_size_alloc_test", random_size_alloc_test },
+	{ "long_busy_list_alloc_test", long_busy_list_alloc_test },
+	{ "map_ram_test", map_ram_test },
+};
+
+#define NR_TEST_CASES	ARRAY_SIZE(test_cases)
+
+struct test_stats {
+	u64 ns;			/* time spent in the pattern */
+	unsigned long ops;	/* alloc/free pairs done */
+	unsigned long errors;
+};
+
+struct test_thread {
+	struct task_struct *task;
+	struct test_stats stats[NR_TEST_CASES];
+} ____cacheline_aligned_in_smp;
+
+static struct test_thread *test_threads;
+static struct task_struct *stats_task;
+
+/* Sums over all threads as of the last stats printk */
+static struct test_stats reported[NR_TEST_CASES];
+static ktime_t reported_time;
+
+static int vmalloc_test_thread(void *arg)
+{
+	struct test_thread *t = arg;
+	ktime_t start;
+	int i, err;
+
+	do {
+		for (i = 0; i < NR_TEST_CASES; i++) {
+			if (!(run_test_mask & (1 << i)))
+				continue;
+
+			start = ktime_get();
+			err = test_cases[i].fn();
+			t->stats[i].ns += ktime_to_ns(ktime_sub(ktime_get(),
+								start));
+			if (err)
+				t->stats[i].errors++;
+			else
+				t->stats[i].ops += nr_iterations;
+			cond_resched();
+			if (kthread_should_stop())
+				break;
+		}
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+/*
+ * Print the work done since the last call.  Only ever called by the
+ * stats kthread, or at rmmod once that has been stopped.
+ */
+static void vmalloc_test_stats_print(void)
+{
+	ktime_t now = ktime_get();
+	s64 us = max_t(s64, ktime_us_delta(now, reported_time), 1);
+	int i, j;
+
+	for (j = 0; j < NR_TEST_CASES; j++) {
+		struct test_stats sum = { 0 };
+		u64 ns;
+		unsigned long ops;
+
+		if (!(run_test_mask & (1 << j)))
+			continue;
+
+		for (i = 0; i < nthreads; i++) {
+			struct test_stats *s = &test_threads[i].stats[j];
+
+			sum.ns += ACCESS_ONCE(s->ns);
+			sum.ops += ACCESS_ONCE(s->ops);
+			sum.errors += ACCESS_ONCE(s->errors);
+		}
+
+		ns = sum.ns - reported[j].ns;
+		ops = sum.ops - reported[j].ops;
+		printk(KERN_ALERT "test_vmalloc: %d threads: %-26s "
+		       "%6llu ns/op %10llu ops/s%s\n",
+		       nthreads, test_cases[j].name,
+		       ops ? div64_u64(ns, ops) : 0ULL,
+		       div64_u64((u64)ops * USEC_PER_SEC, us),
+		       sum.errors ? " (errors)" : "");
+		reported[j] = sum;
+	}
+	reported_time = now;
+}
+
+static int vmalloc_test_stats(void *arg)
+{
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		vmalloc_test_stats_print();
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+static void vmalloc_test_print_module_parms(const char *tag)
+{
+	printk(KERN_ALERT "test_vmalloc: nthreads=%d nr_iterations=%d "
+	       "run_test_mask=%#x stat_interval=%d: %s\n", nthreads,
+	       nr_iterations, run_test_mask, stat_interval, tag);
+}
+
+static void vmalloc_test_stop_threads(void)
+{
+	int i;
+
+	if (stats_task)
+		kthread_stop(stats_task);
+	stats_task = NULL;
+
+	for (i = 0; i < nthreads; i++) {
+		if (test_threads[i].task)
+			kthread_stop(test_threads[i].task);
+		test_threads[i].task = NULL;
+	}
+}
+
+static void __exit vmalloc_test_cleanup(void)
+{
+	unsigned long errors = 0;
+	int i, j;
+
+	vmalloc_test_stop_threads();
+	vmalloc_test_stats_print();  /* -After- the stats thread is stopped! */
+
+	for (i = 0; i < nthreads; i++)
+		for (j = 0; j < NR_TEST_CASES; j++)
+			errors += test_threads[i].stats[j].errors;
+	kfree(test_threads);
+
+	if (errors)
+		vmalloc_test_print_module_parms("End of test: FAILURE");
+	else
+		vmalloc_test_print_module_parms("End of test: SUCCESS");
+}
+module_exit(vmalloc_test_cleanup);
+
+static int __init vmalloc_test_init(void)
+{
+	struct test_thread *t;
+	int i, cpu, err = 0;
+
+	if (nr_iterations <= 0 || stat_interval < 0)
+		return -EINVAL;
+
+	get_online_cpus();
+	if (nthreads <= 0)
+		nthreads = num_online_cpus();
+
+	test_threads = kcalloc(nthreads, sizeof(*test_threads), GFP_KERNEL);
+	if (!test_threads) {
+		put_online_cpus();
+		return -ENOMEM;
+	}
+
+	vmalloc_test_print_module_parms("Start of test");
+	reported_time = ktime_get();
+
+	cpu = -1;
+	for (i = 0; i < nthreads; i++) {
+		t = &test_threads[i];
+		t->task = kthread_create(vmalloc_test_thread, t,
+					 "vmalloc_test/%d", i);
+		if (IS_ERR(t->task)) {
+			err = PTR_ERR(t->task);
+			t->task = NULL;
+			goto out;
+		}
+
+		/* More threads than CPUs share them round-robin */
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		kthread_bind(t->task, cpu);
+		wake_up_process(t->task);
+	}
+
+	if (stat_interval > 0) {
+		stats_task = kthread_run(vmalloc_test_stats, NULL,
+					 "vmalloc_test_stats");
+		if (IS_ERR(stats_task)) {
+			err = PTR_ERR(stats_task);
+			stats_task = NULL;
+		}
+	}
+
+out:
+	put_online_cpus();
+	if (err) {
+		vmalloc_test_stop_threads();
+		kfree(test_threads);
+	}
+	return err;
+}
+module_init(vmalloc_test_init);
+MODULE_LICENSE("GPL");
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -38,6 +40,9 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	unsigned long deadline;		/* kcompactd time budget, in jiffies */
+	bool timed_out;			/* Run stopped at the deadline */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -456,6 +461,12 @@ static int compact_finished(struct zone *zone,
 	if (fatal_signal_pending(current))
 		return COMPACT_PARTIAL;
 
+	/* kcompactd: stop when the budget for this wakeup is used up */
+	if (cc->deadline && time_after(jiffies, cc->deadline)) {
+		cc->timed_out = true;
+		return COMPACT_PARTIAL;
+	}
+
 	/* Compaction run completes if the migrate and free scanner meet */
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
@@ -558,6 +569,15 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
 	cc->free_pfn &= ~(pageblock_nr_pages-1);
 
+	/* kcompactd goes on where its last run ran out of time */
+	if (cc->deadline && zone->compact_cached_free_pfn &&
+	    zone->compact_cached_migrate_pfn >= cc->migrate_pfn &&
+	    zone->compact_cached_free_pfn <= cc->free_pfn &&
+	    zone->compact_cached_migrate_pfn < zone->compact_cached_free_pfn) {
+		cc->migrate_pfn = zone->compact_cached_migrate_pfn;
+		cc->free_pfn = zone->compact_cached_free_pfn;
+	}
+
 	migrate_prep_local();
 
 	while ((ret = compact_finished(zone, cc)) == COMPACT_CONTINUE) {
@@ -604,6 +624,15 @@ out:
 	cc->nr_freepages -= release_freepages(&cc->freepages);
 	VM_BUG_ON(cc->nr_freepages != 0);
 
+	if (cc->deadline) {
+		zone->compact_cached_migrate_pfn = 0;
+		zone->compact_cached_free_pfn = 0;
+		if (cc->timed_out) {
+			zone->compact_cached_migrate_pfn = cc->migrate_pfn;
+			zone->compact_cached_free_pfn = cc->free_pfn;
+		}
+	}
+
 	return ret;
 }
 
@@ -743,6 +772,251 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd: per-node background compaction.
+ *
+ * kswapd wakes kcompactd when it goes back to sleep after reclaiming for
+ * a high-order request, so the compaction needed to turn those free pages
+ * into a high-order block happens off the allocation path. Independently,
+ * kcompactd looks at its node every kcompactd_interval_ms and compacts
+ * proactively when the fragmentation index for pageblock_order is above
+ * extfrag_threshold, so that THP and other large allocations keep finding
+ * free blocks instead of stalling in direct compaction; this periodic
+ * mode is off by default. Each wakeup may spend at most
+ * kcompactd_budget_ms compacting. A zone whose compaction runs out of
+ * time is deferred like one that was scanned without success, and the
+ * next run goes on where the last one stopped.
+ */
+int sysctl_kcompactd_interval_ms;
+int sysctl_kcompactd_budget_ms = 50;
+
+int sysctl_kcompactd_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int nid, ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	/* Let sleeping kcompactd threads pick up the new interval */
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		wake_up_interruptible(&NODE_DATA(nid)->kcompactd_wait);
+
+	return 0;
+}
+
+/* Returns true if compaction would help an allocation of @order on @pgdat */
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order,
+				    enum zone_type classzone_idx)
+{
+	int zoneid;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_suitable(zone, order) == COMPACT_CONTINUE)
+			return true;
+	}
+
+	return false;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat, int order,
+			      enum zone_type classzone_idx)
+{
+	unsigned long deadline;
+	bool compacted = false, success = false, timed_out = false;
+	int zoneid;
+
+	count_vm_event(KCOMPACTD_WAKE);
+	deadline = jiffies + msecs_to_jiffies(sysctl_kcompactd_budget_ms) + 1;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.sync = true,
+			.deadline = deadline,
+		};
+		int status;
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_deferred(zone))
+			continue;
+
+		if (compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+
+		if (kthread_should_stop())
+			return;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		status = compact_zone(zone, &cc);
+		compacted = true;
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone),
+				      0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			success = true;
+		} else if (status == COMPACT_COMPLETE || cc.timed_out) {
+			/*
+			 * The whole zone was scanned, or the budget ran out
+			 * before it was: back off for a while, the next run
+			 * resumes where this one stopped.
+			 */
+			defer_compaction(zone);
+		}
+
+		if (cc.timed_out) {
+			timed_out = true;
+			break;
+		}
+	}
+
+	if (timed_out)
+		count_vm_event(COMPACTDAEMON_TIMEOUT);
+	if (success)
+		count_vm_event(COMPACTDAEMON_SUCCESS);
+	else if (compacted)
+		count_vm_event(COMPACTDAEMON_FAIL);
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		int interval = sysctl_kcompactd_interval_ms;
+		long timeout = MAX_SCHEDULE_TIMEOUT;
+		enum zone_type classzone_idx;
+		int order;
+
+		if (interval)
+			timeout = msecs_to_jiffies(interval);
+
+		wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat) ||
+				interval != sysctl_kcompactd_interval_ms,
+				timeout);
+		if (kthread_should_stop())
+			break;
+
+		order = pgdat->kcompactd_max_order;
+		classzone_idx = pgdat->kcompactd_classzone_idx;
+		pgdat->kcompactd_max_order = 0;
+		pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+
+		if (!order) {
+			/* Periodic check: keep pageblock sized blocks around */
+			if (!sysctl_kcompactd_interval_ms)
+				continue;
+			order = pageblock_order;
+			classzone_idx = pgdat->nr_zones - 1;
+			if (!kcompactd_node_suitable(pgdat, order,
+						     classzone_idx))
+				continue;
+		}
+
+		kcompactd_do_work(pgdat, order, classzone_idx);
+	}
+
+	return 0;
+}
+
+/*
+ * Called by kswapd when it is done reclaiming for a high-order request.
+ * kcompactd is only woken if compaction is likely to produce a page of
+ * the requested order.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!order)
+		return;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_suitable(pgdat, order, classzone_idx))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (pgdat->kcompactd_classzone_idx > classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined. Caller
+ * must hold lock_memory_hotplug().
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -36,6 +36,8 @@
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#include <linux/err.h>
+#include <crypto/hash.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -189,6 +191,26 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * With adaptive scanning, the batch grows from pages_to_scan up to
+ * max_pages_to_scan while batches keep merging at least one page in
+ * KSM_ADAPT_YIELD scanned, and decays back when nothing merges.
+ */
+#define KSM_ADAPT_YIELD	64
+static unsigned int ksm_adaptive_scan;
+static unsigned int ksm_max_pages_to_scan = 1600;
+static unsigned int ksm_cur_pages_to_scan = 100;
+
+/* Pages merged in the current batch */
+static unsigned long ksm_batch_merged;
+
+/* How calc_checksum() fingerprints a page */
+#define KSM_CHECKSUM_JHASH	0
+#define KSM_CHECKSUM_CRC32C	1
+#define KSM_CHECKSUM_SAMPLED	2
+static unsigned int ksm_checksum = KSM_CHECKSUM_JHASH;
+static struct crypto_shash *ksm_crc32c_tfm;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -247,6 +269,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -453,6 +476,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -540,6 +564,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
@@ -669,11 +694,55 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+static u32 crc32c_page(void *addr)
+{
+	struct {
+		struct shash_desc shash;
+		char ctx[crypto_shash_descsize(ksm_crc32c_tfm)];
+	} desc;
+
+	desc.shash.tfm = ksm_crc32c_tfm;
+	desc.shash.flags = 0;
+	*(u32 *)desc.ctx = 17;
+	crypto_shash_update(&desc.shash, addr, PAGE_SIZE);
+	return *(u32 *)desc.ctx;
+}
+
+/*
+ * Hash KSM_SAMPLE_WORDS words at the start of each of KSM_SAMPLES evenly
+ * spaced stretches of the page.  A change elsewhere in the page goes
+ * unnoticed, but that only costs a wasted unstable tree lookup: nothing
+ * is merged without comparing the whole pages.
+ */
+#define KSM_SAMPLES		32
+#define KSM_SAMPLE_WORDS	8
+
+static u32 sampled_jhash_page(void *addr)
+{
+	u32 checksum = 17;
+	int i;
+
+	for (i = 0; i < KSM_SAMPLES; i++)
+		checksum = jhash2(addr + i * (PAGE_SIZE / KSM_SAMPLES),
+				  KSM_SAMPLE_WORDS, checksum);
+	return checksum;
+}
+
 static u32 calc_checksum(struct page *page)
 {
 	u32 checksum;
 	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	switch (ksm_checksum) {
+	case KSM_CHECKSUM_CRC32C:
+		checksum = crc32c_page(addr);
+		break;
+	case KSM_CHECKSUM_SAMPLED:
+		checksum = sampled_jhash_page(addr);
+		break;
+	default:
+		checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+		break;
+	}
 	kunmap_atomic(addr, KM_USER0);
 	return checksum;
 }
@@ -867,6 +936,10 @@ static int try_to_merge_one_page(struct vm_area_struct *vma,
 	if (!PageAnon(page))
 		goto out;
 
+	/* A lazily freed (MADV_FREE) page is better dropped than merged */
+	if (!PageSwapBacked(page))
+		goto out;
+
 	/*
 	 * We need the page lock to read a stable PageSwapCache in
 	 * write_protect_page().  We use trylock_page() instead of
@@ -1157,6 +1230,8 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
+	ksm_batch_merged++;
 }
 
 /*
@@ -1265,6 +1340,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -1417,12 +1493,34 @@ static void ksm_do_scan(unsigned int scan_npages)
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
+		rmap_item->mm->ksm_pages_scanned++;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
 	}
 }
 
+/*
+ * ksm_adapt_pages_to_scan - size the next batch from the yield of the last
+ * @scanned - number of pages the last batch was asked to scan
+ */
+static void ksm_adapt_pages_to_scan(unsigned int scanned)
+{
+	unsigned int nr_pages = ksm_cur_pages_to_scan;
+	unsigned int min_pages = ksm_thread_pages_to_scan;
+	unsigned int max_pages = max(ksm_max_pages_to_scan, min_pages);
+
+	if (!ksm_adaptive_scan)
+		nr_pages = min_pages;
+	else if (ksm_batch_merged * KSM_ADAPT_YIELD >= scanned)
+		nr_pages = min_t(u64, (u64)nr_pages * 2, max_pages);
+	else if (!ksm_batch_merged)
+		nr_pages -= nr_pages / 8;
+
+	ksm_cur_pages_to_scan = clamp(nr_pages, min_pages, max_pages);
+	ksm_batch_merged = 0;
+}
+
 static int ksmd_should_run(void)
 {
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
@@ -1435,8 +1533,12 @@ static int ksm_scan_thread(void *nothing)
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+		if (ksmd_should_run()) {
+			unsigned int nr_pages = ksm_cur_pages_to_scan;
+
+			ksm_do_scan(nr_pages);
+			ksm_adapt_pages_to_scan(nr_pages);
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -1867,11 +1969,120 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 		return -EINVAL;
 
 	ksm_thread_pages_to_scan = nr_pages;
+	if (!ksm_adaptive_scan)
+		ksm_cur_pages_to_scan = nr_pages;
 
 	return count;
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t adaptive_scan_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive_scan);
+}
+
+static ssize_t adaptive_scan_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned long enable;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	ksm_adaptive_scan = enable;
+
+	return count;
+}
+KSM_ATTR(adaptive_scan);
+
+static ssize_t max_pages_to_scan_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_max_pages_to_scan);
+}
+
+static ssize_t max_pages_to_scan_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	ksm_max_pages_to_scan = nr_pages;
+
+	return count;
+}
+KSM_ATTR(max_pages_to_scan);
+
+static ssize_t cur_pages_to_scan_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_cur_pages_to_scan);
+}
+KSM_ATTR_RO(cur_pages_to_scan);
+
+static const char *ksm_checksum_names[] = {
+	[KSM_CHECKSUM_JHASH]	= "jhash",
+	[KSM_CHECKSUM_CRC32C]	= "crc32c",
+	[KSM_CHECKSUM_SAMPLED]	= "sampled",
+};
+
+static ssize_t checksum_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	int i, count = 0;
+
+	for (i = 0; i < ARRAY_SIZE(ksm_checksum_names); i++)
+		count += sprintf(buf + count,
+				 i == ksm_checksum ? "[%s] " : "%s ",
+				 ksm_checksum_names[i]);
+	buf[count - 1] = '\n';
+	return count;
+}
+
+static ssize_t checksum_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ksm_checksum_names); i++)
+		if (sysfs_streq(buf, ksm_checksum_names[i]))
+			break;
+	if (i == ARRAY_SIZE(ksm_checksum_names))
+		return -EINVAL;
+
+	/*
+	 * Checksums only tell ksmd which pages are volatile, so switching
+	 * just holds each page back from the unstable tree for one pass.
+	 */
+	mutex_lock(&ksm_thread_mutex);
+	if (i == KSM_CHECKSUM_CRC32C && !ksm_crc32c_tfm) {
+		struct crypto_shash *tfm = crypto_alloc_shash("crc32c", 0, 0);
+
+		if (IS_ERR(tfm)) {
+			mutex_unlock(&ksm_thread_mutex);
+			return PTR_ERR(tfm);
+		}
+		printk(KERN_INFO "ksm: using %s for page checksums\n",
+		       crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm)));
+		ksm_crc32c_tfm = tfm;
+	}
+	ksm_checksum = i;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(checksum);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1970,6 +2181,10 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&adaptive_scan_attr.attr,
+	&max_pages_to_scan_attr.attr,
+	&cur_pages_to_scan_attr.attr,
+	&checksum_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
@@ -259,6 +259,13 @@ struct mem_cgroup {
 	/* set when res.limit == memsw.limit */
 	bool		memsw_is_minimum;
 
+	/*
+	 * Usage above which background reclaim starts, and the work
+	 * doing it. See mem_cgroup_check_high().
+	 */
+	unsigned long long high;
+	struct work_struct high_work;
+
 	/* protect arrays of thresholds */
 	struct mutex thresholds_lock;
 
@@ -1994,9 +2001,16 @@ EXPORT_SYMBOL(mem_cgroup_update_page_stat);
  * TODO: maybe necessary to use big numbers in big irons.
  */
 #define CHARGE_BATCH	32U
+/*
+ * Every cpu keeps pre-charged pages for the last few memcgs that charged
+ * on it, so that tasks of several groups sharing a cpu all charge from
+ * the stock instead of going to the res_counters of the hierarchy.
+ */
+#define MEMCG_STOCK_ENTRIES	4
 struct memcg_stock_pcp {
-	struct mem_cgroup *cached; /* this never be root cgroup */
-	unsigned int nr_pages;
+	struct mem_cgroup *cached[MEMCG_STOCK_ENTRIES]; /* never root cgroup */
+	unsigned int nr_pages[MEMCG_STOCK_ENTRIES];
+	unsigned int next_victim;
 	struct work_struct work;
 	unsigned long flags;
 #define FLUSHING_CACHED_CHARGE	(0)
@@ -2013,33 +2027,48 @@ static DEFINE_MUTEX(percpu_charge_mutex);
 static bool consume_stock(struct mem_cgroup *memcg)
 {
 	struct memcg_stock_pcp *stock;
-	bool ret = true;
+	bool ret = false;
+	int i;
 
 	stock = &get_cpu_var(memcg_stock);
-	if (memcg == stock->cached && stock->nr_pages)
-		stock->nr_pages--;
-	else /* need to call res_counter_charge */
-		ret = false;
+	for (i = 0; i < MEMCG_STOCK_ENTRIES; i++) {
+		if (memcg == stock->cached[i] && stock->nr_pages[i]) {
+			stock->nr_pages[i]--;
+			ret = true;
+			break;
+		}
+	}
 	put_cpu_var(memcg_stock);
 	return ret;
 }
 
 /*
- * Returns stocks cached in percpu to res_counter and reset cached information.
+ * Returns one stock entry cached in percpu to res_counter and resets it.
  */
-static void drain_stock(struct memcg_stock_pcp *stock)
+static void drain_stock_entry(struct memcg_stock_pcp *stock, int i)
 {
-	struct mem_cgroup *old = stock->cached;
+	struct mem_cgroup *old = stock->cached[i];
 
-	if (stock->nr_pages) {
-		unsigned long bytes = stock->nr_pages * PAGE_SIZE;
+	if (stock->nr_pages[i]) {
+		unsigned long bytes = stock->nr_pages[i] * PAGE_SIZE;
 
 		res_counter_uncharge(&old->res, bytes);
 		if (do_swap_account)
 			res_counter_uncharge(&old->memsw, bytes);
-		stock->nr_pages = 0;
+		stock->nr_pages[i] = 0;
 	}
-	stock->cached = NULL;
+	stock->cached[i] = NULL;
+}
+
+/*
+ * Returns stocks cached in percpu to res_counter and reset cached information.
+ */
+static void drain_stock(struct memcg_stock_pcp *stock)
+{
+	int i;
+
+	for (i = 0; i < MEMCG_STOCK_ENTRIES; i++)
+		drain_stock_entry(stock, i);
 }
 
 /*
@@ -2060,12 +2089,26 @@ static void drain_local_stock(struct work_struct *dummy)
 static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 {
 	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+	int i, empty = -1;
 
-	if (stock->cached != memcg) { /* reset if necessary */
-		drain_stock(stock);
-		stock->cached = memcg;
+	for (i = 0; i < MEMCG_STOCK_ENTRIES; i++) {
+		if (stock->cached[i] == memcg)
+			goto found;
+		if (empty < 0 && !stock->nr_pages[i])
+			empty = i;
 	}
-	stock->nr_pages += nr_pages;
+
+	/* reuse a drained entry, or else evict them in turn */
+	if (empty >= 0) {
+		i = empty;
+	} else {
+		i = stock->next_victim;
+		stock->next_victim = (i + 1) % MEMCG_STOCK_ENTRIES;
+	}
+	drain_stock_entry(stock, i);
+	stock->cached[i] = memcg;
+found:
+	stock->nr_pages[i] += nr_pages;
 	put_cpu_var(memcg_stock);
 }
 
@@ -2084,11 +2127,16 @@ static void drain_all_stock(struct mem_cgroup *root_memcg, bool sync)
 	for_each_online_cpu(cpu) {
 		struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
 		struct mem_cgroup *memcg;
-
-		memcg = stock->cached;
-		if (!memcg || !stock->nr_pages)
-			continue;
-		if (!mem_cgroup_same_or_subtree(root_memcg, memcg))
+		bool cached = false;
+		int i;
+
+		for (i = 0; i < MEMCG_STOCK_ENTRIES && !cached; i++) {
+			memcg = stock->cached[i];
+			if (memcg && stock->nr_pages[i] &&
+			    mem_cgroup_same_or_subtree(root_memcg, memcg))
+				cached = true;
+		}
+		if (!cached)
 			continue;
 		if (!test_and_set_bit(FLUSHING_CACHED_CHARGE, &stock->flags)) {
 			if (cpu == curcpu)
@@ -2198,6 +2246,90 @@ static int __cpuinit memcg_cpu_hotplug_callback(struct notifier_block *nb,
 }
 
 
+/*
+ * Background reclaim above the high limit.
+ *
+ * When a charge takes the usage of a group above its high limit, a work
+ * item is queued that reclaims from the group (and its children) until
+ * the usage is back below the limit. It runs on a cpu of one of the
+ * nodes the group has memory on. The charging task only has to reclaim
+ * itself when the usage gets too far ahead of the background reclaim:
+ * halfway from the high limit to the hard limit, and at most an eighth
+ * of the high limit above it.
+ */
+static struct workqueue_struct *memcg_high_wq;
+
+static void mem_cgroup_high_work(struct work_struct *work)
+{
+	struct mem_cgroup *memcg;
+	int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+
+	memcg = container_of(work, struct mem_cgroup, high_work);
+
+	while (res_counter_read_u64(&memcg->res, RES_USAGE) >
+	       ACCESS_ONCE(memcg->high)) {
+		if (!mem_cgroup_hierarchical_reclaim(memcg, NULL, GFP_KERNEL,
+					MEM_CGROUP_RECLAIM_SHRINK, NULL) &&
+		    !--nr_retries)
+			break;
+		cond_resched();
+	}
+	css_put(&memcg->css);
+}
+
+static void mem_cgroup_schedule_high_work(struct mem_cgroup *memcg)
+{
+	int cpu;
+
+	if (!memcg_high_wq || work_pending(&memcg->high_work))
+		return;
+
+	/* Disabling preemption keeps the cpu from going offline under us */
+	preempt_disable();
+	cpu = cpumask_any_and(cpumask_of_node(
+			mem_cgroup_select_victim_node(memcg)), cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = smp_processor_id();
+	css_get(&memcg->css);
+	if (!queue_work_on(cpu, memcg_high_wq, &memcg->high_work))
+		css_put(&memcg->css);
+	preempt_enable();
+}
+
+/*
+ * Called after a charge went to the res_counters of @memcg's hierarchy.
+ */
+static void mem_cgroup_check_high(struct mem_cgroup *memcg, gfp_t gfp_mask)
+{
+	unsigned long long usage, high, limit, behind;
+
+	for (; memcg; memcg = parent_mem_cgroup(memcg)) {
+		high = ACCESS_ONCE(memcg->high);
+		if (high == RESOURCE_MAX)
+			continue;
+		usage = res_counter_read_u64(&memcg->res, RES_USAGE);
+		if (usage <= high)
+			continue;
+
+		mem_cgroup_schedule_high_work(memcg);
+
+		limit = res_counter_read_u64(&memcg->res, RES_LIMIT);
+		if (high >= limit)
+			continue;
+		behind = min(high >> 3, (limit - high) >> 1);
+		if (usage - high > behind && (gfp_mask & __GFP_WAIT))
+			mem_cgroup_hierarchical_reclaim(memcg, NULL, gfp_mask,
+					MEM_CGROUP_RECLAIM_SHRINK, NULL);
+	}
+}
+
+static int __init mem_cgroup_high_init(void)
+{
+	memcg_high_wq = alloc_workqueue("memcg_high", WQ_MEM_RECLAIM, 0);
+	return memcg_high_wq ? 0 : -ENOMEM;
+}
+module_init(mem_cgroup_high_init);
+
 /* See __mem_cgroup_try_charge() for details */
 enum {
 	CHARGE_OK,		/* success */
@@ -2400,6 +2532,7 @@ again:
 
 	if (batch > nr_pages)
 		refill_stock(memcg, batch - nr_pages);
+	mem_cgroup_check_high(memcg, gfp_mask);
 	css_put(&memcg->css);
 done:
 	*ptr = memcg;
@@ -3800,7 +3933,7 @@ move_account:
 			goto try_to_free;
 		cond_resched();
 	/* "ret" should also be checked to ensure all lists are empty. */
-	} while (memcg->res.usage > 0 || ret);
+	} while (res_counter_read_u64(&memcg->res, RES_USAGE) > 0 || ret);
 out:
 	css_put(&memcg->css);
 	return ret;
@@ -3815,7 +3948,8 @@ try_to_free:
 	lru_add_drain_all();
 	/* try to free all pages in this cgroup */
 	shrink = 1;
-	while (nr_retries && memcg->res.usage > 0) {
+	while (nr_retries &&
+	       res_counter_read_u64(&memcg->res, RES_USAGE) > 0) {
 		int progress;
 
 		if (signal_pending(current)) {
@@ -3993,6 +4127,31 @@ static int mem_cgroup_write(struct cgroup *cont, struct cftype *cft,
 	return ret;
 }
 
+static u64 mem_cgroup_high_read(struct cgroup *cont, struct cftype *cft)
+{
+	return mem_cgroup_from_cont(cont)->high;
+}
+
+static int mem_cgroup_high_write(struct cgroup *cont, struct cftype *cft,
+				 const char *buffer)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cont);
+	unsigned long long val;
+	int ret;
+
+	if (mem_cgroup_is_root(memcg)) /* the root is never charged */
+		return -EINVAL;
+
+	ret = res_counter_memparse_write_strategy(buffer, &val);
+	if (ret)
+		return ret;
+
+	memcg->high = val;
+	if (res_counter_read_u64(&memcg->res, RES_USAGE) > val)
+		mem_cgroup_schedule_high_work(memcg);
+	return 0;
+}
+
 static void memcg_get_hierarchical_limit(struct mem_cgroup *memcg,
 		unsigned long long *mem_limit, unsigned long long *memsw_limit)
 {
@@ -4700,6 +4859,11 @@ static struct cftype mem_cgroup_files[] = {
 		.write_string = mem_cgroup_write,
 		.read_u64 = mem_cgroup_read,
 	},
+	{
+		.name = "high_limit_in_bytes",
+		.write_string = mem_cgroup_high_write,
+		.read_u64 = mem_cgroup_high_read,
+	},
 	{
 		.name = "failcnt",
 		.private = MEMFILE_PRIVATE(_MEM, RES_FAILCNT),
@@ -5001,6 +5165,8 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	memcg->last_scanned_child = 0;
 	memcg->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&memcg->oom_notify);
+	memcg->high = RESOURCE_MAX;
+	INIT_WORK(&memcg->high_work, mem_cgroup_high_work);
 
 	if (parent)
 		memcg->swappiness = mem_cgroup_swappiness(parent);
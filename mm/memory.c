@@ -57,6 +57,7 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/migrate.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -3433,6 +3434,70 @@ static int do_nonlinear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * A pte that change_prot_numa() made inaccessible in a vma that allows
+ * access; see pte_protnone().
+ */
+static inline int pte_numa(struct vm_area_struct *vma, pte_t pte)
+{
+	return pte_protnone(pte) &&
+		(vma->vm_flags & (VM_READ | VM_WRITE | VM_EXEC));
+}
+
+/*
+ * Handle a NUMA hinting fault: make the pte accessible again, then
+ * check whether the page sits on the node the memory policy wants and
+ * migrate it there if not. The node the page ends up on is accounted
+ * to the faulting task, which uses it to choose where to run.
+ */
+static int do_numa_page(struct mm_struct *mm, struct vm_area_struct *vma,
+		unsigned long addr, pte_t pte, pte_t *ptep, pmd_t *pmd)
+{
+	struct page *page;
+	spinlock_t *ptl;
+	int page_nid, target_nid;
+	bool migrated = false;
+
+	ptl = pte_lockptr(mm, pmd);
+	spin_lock(ptl);
+	if (unlikely(!pte_same(*ptep, pte))) {
+		pte_unmap_unlock(ptep, ptl);
+		return 0;
+	}
+
+	pte = pte_mkyoung(pte_modify(pte, vma->vm_page_prot));
+	set_pte_at(mm, addr, ptep, pte);
+	update_mmu_cache(vma, addr, ptep);
+
+	page = vm_normal_page(vma, addr, pte);
+	if (!page) {
+		pte_unmap_unlock(ptep, ptl);
+		return 0;
+	}
+
+	count_vm_event(NUMA_HINT_FAULTS);
+	get_page(page);
+	page_nid = page_to_nid(page);
+	if (page_nid == numa_node_id())
+		count_vm_event(NUMA_HINT_FAULTS_LOCAL);
+	target_nid = mpol_misplaced(page, vma, addr);
+	pte_unmap_unlock(ptep, ptl);
+
+	if (target_nid == -1) {
+		put_page(page);
+	} else {
+		/* Migrate to the requested node, dropping our reference */
+		migrated = migrate_misplaced_page(page, target_nid);
+		if (migrated)
+			page_nid = target_nid;
+	}
+
+	task_numa_fault(page_nid, 1, migrated);
+	return 0;
+}
+#endif /* CONFIG_NUMA_BALANCING */
+
 /*
  * These routines also need to handle stuff like marking pages dirty
  * and/or accessed for architectures that don't do it in hardware (most
@@ -3471,6 +3536,11 @@ int handle_pte_fault(struct mm_struct *mm,
 					pte, pmd, flags, entry);
 	}
 
+#ifdef CONFIG_NUMA_BALANCING
+	if (pte_numa(vma, entry))
+		return do_numa_page(mm, vma, address, entry, pte, pmd);
+#endif
+
 	ptl = pte_lockptr(mm, pmd);
 	spin_lock(ptl);
 	if (unlikely(!pte_same(*pte, entry)))
@@ -1639,6 +1639,88 @@ unsigned slab_node(struct mempolicy *policy)
 	}
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Mark the ptes in [addr, end) of @vma PROT_NONE so that the next access
+ * takes a NUMA hinting fault. Returns the number of ptes updated. The
+ * caller must hold mmap_sem for reading.
+ */
+unsigned long change_prot_numa(struct vm_area_struct *vma,
+			unsigned long addr, unsigned long end)
+{
+	unsigned long nr_updated;
+
+	nr_updated = change_protection(vma, addr, end, PAGE_NONE, 0, 1);
+	if (nr_updated)
+		count_vm_events(NUMA_PTE_UPDATES, nr_updated);
+
+	return nr_updated;
+}
+
+/**
+ * mpol_misplaced - check whether current page node is valid in policy
+ *
+ * @page: page to be checked
+ * @vma: vm area where page mapped
+ * @addr: virtual address where page mapped
+ *
+ * Lookup current policy node id for vma,addr and "compare to" page's
+ * node id. The default (local) policy asks for the node of the CPU
+ * taking the fault, so this is where pages follow their users.
+ *
+ * Returns:
+ *	-1	- not misplaced, page is in the right node
+ *	node	- node id where the page should be
+ *
+ * Policy determination "mimics" alloc_page_vma().
+ * Called from fault path where we know the vma and faulting address.
+ */
+int mpol_misplaced(struct page *page, struct vm_area_struct *vma,
+		   unsigned long addr)
+{
+	struct mempolicy *pol;
+	int curnid = page_to_nid(page);
+	int thisnid = numa_node_id();
+	int polnid = -1;
+	int ret = -1;
+
+	pol = get_vma_policy(current, vma, addr);
+
+	switch (pol->mode) {
+	case MPOL_INTERLEAVE:
+		/* pages were spread out deliberately, leave them be */
+		goto out;
+
+	case MPOL_PREFERRED:
+		if (pol->flags & MPOL_F_LOCAL)
+			polnid = thisnid;
+		else
+			polnid = pol->v.preferred_node;
+		break;
+
+	case MPOL_BIND:
+		/*
+		 * allows binding to multiple nodes: only move the page
+		 * if the faulting node is one of them.
+		 */
+		if (!node_isset(thisnid, pol->v.nodes))
+			goto out;
+		polnid = thisnid;
+		break;
+
+	default:
+		BUG();
+	}
+
+	if (curnid != polnid)
+		ret = polnid;
+out:
+	mpol_cond_put(pol);
+
+	return ret;
+}
+#endif /* CONFIG_NUMA_BALANCING */
+
 /* Do static interleaving for a VMA with known offset. */
 static unsigned offset_il_node(struct mempolicy *pol,
 		struct vm_area_struct *vma, unsigned long off)
@@ -0,0 +1,268 @@
+/*
+ * Readahead accounting test
+ *
+ * A kernel thread reads the file given by the path parameter from start
+ * to end in req_pages sized requests, the way cat or cp do, dropping its
+ * page cache and resetting its readahead state before every pass, until
+ * the module is removed.  Every readahead window that gets checked for
+ * use is seen through the readahead_account tracepoint.
+ *
+ * Every stat_interval seconds, and at rmmod, the passes and throughput
+ * since the previous report are printed, with the share of the checked
+ * readahead pages that were used.  A plain sequential read uses all of
+ * its readahead: the test fails if less than min_hit_pct percent of the
+ * checked pages were used overall, or if readahead got turned off for
+ * the file in any pass.
+ *
+ * The file should be a few times larger than the readahead window of
+ * its device.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/uaccess.h>
+#include <linux/pagemap.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <trace/events/readahead.h>
+
+static char *path;
+module_param(path, charp, 0444);
+MODULE_PARM_DESC(path, "File to read");
+
+static int req_pages = 1;
+module_param(req_pages, int, 0444);
+MODULE_PARM_DESC(req_pages, "Size of each read() in pages");
+
+static int min_hit_pct = 90;
+module_param(min_hit_pct, int, 0444);
+MODULE_PARM_DESC(min_hit_pct,
+		 "Percentage of readahead that must be used to pass");
+
+static int stat_interval = 60;
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval,
+		 "Number of seconds between stats printk()s, 0 for only at rmmod");
+
+struct ra_test_stats {
+	unsigned long passes;
+	unsigned long ra_off;	/* passes that ended with readahead off */
+	unsigned long errors;
+	u64 bytes;
+	unsigned long windows;
+	unsigned long pages;
+	unsigned long hit;
+};
+
+/* Updated by the reader thread and the tracepoint probe it triggers */
+static struct ra_test_stats cur;
+/* As of the last stats printk */
+static struct ra_test_stats reported;
+static ktime_t reported_time;
+
+static struct file *test_filp;
+static char *read_buf;
+static struct task_struct *reader_task;
+static struct task_struct *stats_task;
+
+static void ra_account_probe(void *data, struct address_space *mapping,
+			     pgoff_t start, unsigned long size,
+			     unsigned long hit, unsigned int hit_ratio)
+{
+	if (mapping != data || !size)
+		return;
+	cur.windows++;
+	cur.pages += size;
+	cur.hit += hit;
+}
+
+/* Read the whole file once from a cold page cache */
+static void readahead_test_pass(void)
+{
+	struct address_space *mapping = test_filp->f_mapping;
+	size_t len = req_pages * PAGE_SIZE;
+	mm_segment_t old_fs;
+	loff_t pos = 0;
+	ssize_t ret;
+
+	invalidate_mapping_pages(mapping, 0, -1);
+	file_ra_state_init(&test_filp->f_ra, mapping);
+
+	old_fs = get_fs();
+	set_fs(get_ds());
+	do {
+		ret = vfs_read(test_filp, (char __user *)read_buf, len, &pos);
+		if (ret > 0)
+			cur.bytes += ret;
+	} while (ret > 0 && !kthread_should_stop());
+	set_fs(old_fs);
+
+	if (ret < 0) {
+		printk(KERN_ERR "readahead_test: read failed at %lld: %zd\n",
+		       pos, ret);
+		cur.errors++;
+		schedule_timeout_interruptible(HZ);
+		return;
+	}
+	if (ret)	/* stopped halfway */
+		return;
+
+	cur.passes++;
+	if (test_filp->f_ra.pattern == RA_PATTERN_RANDOM)
+		cur.ra_off++;
+}
+
+static int readahead_test_reader(void *arg)
+{
+	do {
+		readahead_test_pass();
+		cond_resched();
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+static unsigned long hit_pct(unsigned long hit, unsigned long pages)
+{
+	return pages ? hit * 100 / pages : 0;
+}
+
+/*
+ * Print the reads since the last call.  Only ever called by the stats
+ * kthread, or at rmmod once that has been stopped.
+ */
+static void readahead_test_stats_print(void)
+{
+	struct ra_test_stats now_stats = cur;
+	ktime_t now = ktime_get();
+	s64 us = max_t(s64, ktime_us_delta(now, reported_time), 1);
+	unsigned long pages = now_stats.pages - reported.pages;
+	unsigned long hit = now_stats.hit - reported.hit;
+
+	printk(KERN_ALERT "readahead_test: %s: %lu passes, %llu KB/s, "
+	       "ra_pages %u: %lu windows checked, %lu of %lu readahead "
+	       "pages used (%lu%%), readahead off in %lu passes\n",
+	       path, now_stats.passes - reported.passes,
+	       div64_u64((now_stats.bytes - reported.bytes) * USEC_PER_SEC,
+			 us) >> 10,
+	       test_filp->f_ra.ra_pages,
+	       now_stats.windows - reported.windows, hit, pages,
+	       hit_pct(hit, pages), now_stats.ra_off - reported.ra_off);
+
+	reported = now_stats;
+	reported_time = now;
+}
+
+static int readahead_test_stats(void *arg)
+{
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		readahead_test_stats_print();
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+static void readahead_test_print_module_parms(const char *tag)
+{
+	printk(KERN_ALERT "readahead_test: path=%s req_pages=%d "
+	       "min_hit_pct=%d stat_interval=%d: %s\n", path, req_pages,
+	       min_hit_pct, stat_interval, tag);
+}
+
+static void readahead_test_stop(void)
+{
+	if (stats_task)
+		kthread_stop(stats_task);
+	stats_task = NULL;
+	if (reader_task)
+		kthread_stop(reader_task);
+	reader_task = NULL;
+
+	unregister_trace_readahead_account(ra_account_probe,
+					   test_filp->f_mapping);
+	tracepoint_synchronize_unregister();
+	kfree(read_buf);
+}
+
+static void __exit readahead_test_cleanup(void)
+{
+	bool failed;
+
+	readahead_test_stop();
+	readahead_test_stats_print();  /* -After- the stats thread is stopped! */
+	fput(test_filp);
+
+	if (!cur.windows)
+		printk(KERN_WARNING "readahead_test: no window was checked, "
+		       "the file is too small\n");
+	failed = cur.errors || cur.ra_off ||
+		 hit_pct(cur.hit, cur.pages) < min_hit_pct;
+	if (failed)
+		readahead_test_print_module_parms("End of test: FAILURE");
+	else
+		readahead_test_print_module_parms("End of test: SUCCESS");
+}
+module_exit(readahead_test_cleanup);
+
+static int __init readahead_test_init(void)
+{
+	int err;
+
+	if (!path || req_pages <= 0 || min_hit_pct < 0 || min_hit_pct > 100 ||
+	    stat_interval < 0)
+		return -EINVAL;
+
+	test_filp = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(test_filp))
+		return PTR_ERR(test_filp);
+
+	read_buf = kmalloc(req_pages * PAGE_SIZE, GFP_KERNEL);
+	if (!read_buf) {
+		err = -ENOMEM;
+		goto out_fput;
+	}
+
+	err = register_trace_readahead_account(ra_account_probe,
+					       test_filp->f_mapping);
+	if (err)
+		goto out_free;
+
+	readahead_test_print_module_parms("Start of test");
+	reported_time = ktime_get();
+
+	reader_task = kthread_run(readahead_test_reader, NULL,
+				  "readahead_test");
+	if (IS_ERR(reader_task)) {
+		err = PTR_ERR(reader_task);
+		reader_task = NULL;
+		goto out_stop;
+	}
+
+	if (stat_interval > 0) {
+		stats_task = kthread_run(readahead_test_stats, NULL,
+					 "readahead_test_stats");
+		if (IS_ERR(stats_task)) {
+			err = PTR_ERR(stats_task);
+			stats_task = NULL;
+			goto out_stop;
+		}
+	}
+	return 0;
+
+out_stop:
+	readahead_test_stop();	/* frees read_buf */
+	goto out_fput;
+out_free:
+	kfree(read_buf);
+out_fput:
+	fput(test_filp);
+	return err;
+}
+module_init(readahead_test_init);
+MODULE_LICENSE("GPL");
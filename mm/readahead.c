@@ -18,6 +18,11 @@
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/readahead.h>
+
+EXPORT_TRACEPOINT_SYMBOL_GPL(readahead_account);
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -27,6 +32,10 @@ file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
 	ra->ra_pages = mapping->backing_dev_info->ra_pages;
 	ra->prev_pos = -1;
+	ra->pattern = RA_PATTERN_SEQUENTIAL;
+	ra->nr_miss = 0;
+	ra->acct_size[0] = ra->acct_size[1] = 0;
+	ra->hit = ra->total = 0;
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
 
@@ -334,7 +343,216 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
+ *
+ * Misses that fit none of the above are remembered in ra->miss[]. Three
+ * misses the same distance apart start a strided stream (backward scans
+ * are strides with a negative distance): the following chunks are read
+ * and the last one is marked with PG_readahead, so that the stream goes
+ * on asynchronously like a sequential one. Misses bunched up within one
+ * readahead window read the whole window around them.
+ *
+ * The speculative part of each readahead is checked for use when the
+ * one after the next is submitted, once the reader has gone past it.
+ * Files on which most of it goes unused fall
+ * back to RA_PATTERN_RANDOM and only read what is asked for, until a
+ * sequential or strided stream shows up again.
+ */
+
+#define RA_STRIDE_CHUNKS	8	/* chunks read ahead of a strided stream */
+#define RA_ACCOUNT_PAGES	256	/* pages between hit ratio decisions */
+#define RA_MIN_HIT_RATIO	20	/* percent of readahead that must be used */
+
+/*
+ * Remember the window [@start, @start + @size) just submitted, and check
+ * the readahead pages of the window submitted before the previous one
+ * for use. The previous window cannot be checked yet: a sequential reader
+ * submits a new window when it hits the marker on the first page of the
+ * previous one, which it has barely started reading. The one before that
+ * has been consumed by now if it was useful, so its pages are referenced,
+ * active or mapped. Pages that are not, or that have been reclaimed
+ * already, were wasted.
+ */
+static void ra_account(struct address_space *mapping,
+		       struct file_ra_state *ra, pgoff_t start,
+		       unsigned long size)
+{
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
+	pgoff_t index = ra->acct_start[1];
+	unsigned long nr = ra->acct_size[1];
+	pgoff_t end = index + nr;
+	unsigned long hit = 0;
+	unsigned int hit_ratio;
+	struct pagevec pvec;
+	int i;
+
+	ra->acct_start[1] = ra->acct_start[0];
+	ra->acct_size[1] = ra->acct_size[0];
+	ra->acct_start[0] = start;
+	ra->acct_size[0] = size;
+	if (!nr)
+		return;
+
+	pagevec_init(&pvec, 0);
+	while (index < end && pagevec_lookup(&pvec, mapping, index,
+			min_t(pgoff_t, end - index, PAGEVEC_SIZE))) {
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			struct page *page = pvec.pages[i];
+
+			if (page->index >= end)
+				break;
+			if (PageReferenced(page) || PageActive(page) ||
+			    page_mapped(page))
+				hit++;
+		}
+		index = pvec.pages[pagevec_count(&pvec) - 1]->index + 1;
+		pagevec_release(&pvec);
+	}
+
+	__add_bdi_stat(bdi, BDI_RA_HIT, hit);
+	__add_bdi_stat(bdi, BDI_RA_WASTE, nr - hit);
+
+	ra->hit += hit;
+	ra->total += nr;
+	hit_ratio = ra->hit * 100 / ra->total;
+	trace_readahead_account(mapping, end - nr, nr, hit, hit_ratio);
+
+	if (ra->total >= RA_ACCOUNT_PAGES) {
+		if (hit_ratio < RA_MIN_HIT_RATIO)
+			ra->pattern = RA_PATTERN_RANDOM;
+		ra->hit /= 2;
+		ra->total /= 2;
+	}
+}
+
+static void ra_record_miss(struct file_ra_state *ra, pgoff_t offset)
+{
+	memmove(ra->miss + 1, ra->miss,
+		(RA_MISS_HISTORY - 1) * sizeof(ra->miss[0]));
+	ra->miss[0] = offset;
+	if (ra->nr_miss < RA_MISS_HISTORY)
+		ra->nr_miss++;
+}
+
+/*
+ * Look for a strided or clustered pattern in the recent cache misses,
+ * the newest of which is the current one. Returns RA_PATTERN_RANDOM if
+ * there is none.
+ */
+static unsigned int ra_detect_pattern(struct file_ra_state *ra,
+				      unsigned long req_size,
+				      unsigned long max)
+{
+	pgoff_t lo, hi;
+	long stride;
+	int i;
+
+	if (ra->nr_miss < 3)
+		return RA_PATTERN_RANDOM;
+
+	/* Forward strides of req_size are sequential reads */
+	stride = ra->miss[0] - ra->miss[1];
+	if (stride == (long)(ra->miss[1] - ra->miss[2]) &&
+	    (stride < 0 || stride > req_size)) {
+		ra->stride = stride;
+		return RA_PATTERN_STRIDE;
+	}
+
+	if (ra->nr_miss < RA_MISS_HISTORY || ra->pattern == RA_PATTERN_RANDOM)
+		return RA_PATTERN_RANDOM;
+
+	lo = hi = ra->miss[0];
+	for (i = 1; i < RA_MISS_HISTORY; i++) {
+		lo = min(lo, ra->miss[i]);
+		hi = max(hi, ra->miss[i]);
+	}
+	if (hi + req_size - lo <= max)
+		return RA_PATTERN_CLUSTER;
+
+	return RA_PATTERN_RANDOM;
+}
+
+/*
+ * Read ahead the RA_STRIDE_CHUNKS chunks of @chunk pages that follow the
+ * one at @offset in a strided stream, and mark the last of them. @sync
+ * is set for the cache miss that detected the stream: the chunk at
+ * @offset itself has not been read yet then.
  */
+static unsigned long
+stride_readahead(struct address_space *mapping, struct file_ra_state *ra,
+		 struct file *filp, pgoff_t offset, unsigned long chunk,
+		 unsigned long max, bool sync)
+{
+	long stride = ra->stride;
+	unsigned long nr, i;
+	unsigned long actual = 0;
+
+	chunk = clamp(chunk, 1UL, max);
+	nr = min_t(unsigned long, max / chunk, RA_STRIDE_CHUNKS);
+	if (stride < 0)
+		nr = min_t(unsigned long, nr, offset / -stride);
+
+	if (sync)
+		actual = __do_page_cache_readahead(mapping, filp, offset,
+						   chunk, 0);
+	if (!nr)
+		return actual;
+
+	ra->pattern = RA_PATTERN_STRIDE;
+	ra->size = chunk;
+	ra->async_size = chunk;
+
+	if (stride == -(long)chunk) {
+		/* A backward scan: read the chunks below in one go */
+		ra->start = offset - nr * chunk;
+		actual += __do_page_cache_readahead(mapping, filp, ra->start,
+						    nr * chunk, nr * chunk);
+		ra_account(mapping, ra, ra->start, nr * chunk);
+	} else {
+		for (i = 1; i <= nr; i++)
+			actual += __do_page_cache_readahead(mapping, filp,
+					offset + i * stride, chunk,
+					i == nr ? chunk : 0);
+		ra->start = offset + nr * stride;
+		ra_account(mapping, ra, ra->start, chunk);
+	}
+
+	trace_readahead(mapping, offset, chunk, ra->pattern,
+			offset + stride, nr * chunk, actual);
+	return actual;
+}
+
+/*
+ * Read the readahead window around a cluster of cache misses.
+ */
+static unsigned long
+cluster_readahead(struct address_space *mapping, struct file_ra_state *ra,
+		  struct file *filp, pgoff_t offset, unsigned long req_size,
+		  unsigned long max)
+{
+	pgoff_t lo = ra->miss[0], hi = ra->miss[0];
+	unsigned long actual;
+	int i;
+
+	for (i = 1; i < RA_MISS_HISTORY; i++) {
+		lo = min(lo, ra->miss[i]);
+		hi = max(hi, ra->miss[i]);
+	}
+
+	ra->pattern = RA_PATTERN_CLUSTER;
+	ra->start = lo - min(lo, (max - (hi + req_size - lo)) / 2);
+	ra->size = max;
+	ra->async_size = 0;
+	/* Wait for a new cluster before reading this one again */
+	ra->nr_miss = 0;
+
+	actual = __do_page_cache_readahead(mapping, filp, ra->start,
+					   ra->size, 0);
+	ra_account(mapping, ra, ra->start, ra->size);
+
+	trace_readahead(mapping, offset, req_size, ra->pattern,
+			ra->start, ra->size, actual);
+	return actual;
+}
 
 /*
  * Count contiguously cached pages from @offset-1 to @offset-@max,
@@ -399,6 +617,30 @@ ondemand_readahead(struct address_space *mapping,
 		   unsigned long req_size)
 {
 	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long actual;
+	pgoff_t skip;
+
+	/*
+	 * A strided stream hit the marker on its last chunk read ahead.
+	 */
+	if (hit_readahead_marker && ra->pattern == RA_PATTERN_STRIDE &&
+	    offset == ra->start)
+		return stride_readahead(mapping, ra, filp, offset, ra->size,
+					max, false);
+
+	/*
+	 * Readahead has not been paying off for this file. Only read
+	 * ahead again for a sequential miss.
+	 */
+	if (ra->pattern == RA_PATTERN_RANDOM) {
+		if (hit_readahead_marker)
+			return 0;
+		if (req_size <= max &&
+		    offset - (ra->prev_pos >> PAGE_CACHE_SHIFT) > 1UL)
+			goto no_readahead;
+		ra->hit = ra->total = 0;
+		goto initial_readahead;
+	}
 
 	/*
 	 * start of file
@@ -461,6 +703,16 @@ ondemand_readahead(struct address_space *mapping,
 	if (try_context_readahead(mapping, ra, offset, req_size, max))
 		goto readit;
 
+no_readahead:
+	switch (ra_detect_pattern(ra, req_size, max)) {
+	case RA_PATTERN_STRIDE:
+		return stride_readahead(mapping, ra, filp, offset, req_size,
+					max, true);
+	case RA_PATTERN_CLUSTER:
+		return cluster_readahead(mapping, ra, filp, offset, req_size,
+					 max);
+	}
+
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
@@ -483,7 +735,18 @@ readit:
 		ra->size += ra->async_size;
 	}
 
-	return ra_submit(ra, mapping, filp);
+	ra->pattern = RA_PATTERN_SEQUENTIAL;
+	actual = ra_submit(ra, mapping, filp);
+
+	/* The pages of a synchronous read were asked for, not read ahead */
+	skip = 0;
+	if (!hit_readahead_marker && offset == ra->start)
+		skip = min(req_size, (unsigned long)ra->size);
+	ra_account(mapping, ra, ra->start + skip, ra->size - skip);
+
+	trace_readahead(mapping, offset, req_size, ra->pattern,
+			ra->start, ra->size, actual);
+	return actual;
 }
 
 /**
@@ -515,6 +778,7 @@ void page_cache_sync_readahead(struct address_space *mapping,
 	}
 
 	/* do read-ahead */
+	ra_record_miss(ra, offset);
 	ondemand_readahead(mapping, ra, filp, false, offset, req_size);
 }
 EXPORT_SYMBOL_GPL(page_cache_sync_readahead);
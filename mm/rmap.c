@@ -1248,6 +1248,23 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 			}
 			dec_mm_counter(mm, MM_ANONPAGES);
 			inc_mm_counter(mm, MM_SWAPENTS);
+		} else if (!PageSwapBacked(page) &&
+			   TTU_ACTION(flags) != TTU_MIGRATION) {
+			/*
+			 * A lazily freed (MADV_FREE) page, only ever unmapped
+			 * here by reclaim, which has it isolated: drop it if it
+			 * is still clean and nobody but the page tables holds
+			 * a reference, otherwise it is in use again.
+			 */
+			if (PageDirty(page) ||
+			    page_count(page) != 1 + page_mapcount(page)) {
+				set_pte_at(mm, address, pte, pteval);
+				SetPageSwapBacked(page);
+				ret = SWAP_FAIL;
+				goto out_unmap;
+			}
+			dec_mm_counter(mm, MM_ANONPAGES);
+			goto discard;
 		} else if (PAGE_MIGRATION) {
 			/*
 			 * Store the pfn of the page in a special migration
@@ -1267,6 +1284,7 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	} else
 		dec_mm_counter(mm, MM_FILEPAGES);
 
+discard:
 	page_remove_rmap(page);
 	page_cache_release(page);
 
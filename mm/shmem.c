@@ -104,13 +104,14 @@ static unsigned long shmem_default_max_inodes(void)
 #endif
 
 static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
-	struct page **pagep, enum sgp_type sgp, gfp_t gfp, int *fault_type);
+	struct page **pagep, enum sgp_type sgp, gfp_t gfp,
+	struct vm_area_struct *vma, int *fault_type);
 
 static inline int shmem_getpage(struct inode *inode, pgoff_t index,
 	struct page **pagep, enum sgp_type sgp, int *fault_type)
 {
 	return shmem_getpage_gfp(inode, index, pagep, sgp,
-			mapping_gfp_mask(inode->i_mapping), fault_type);
+			mapping_gfp_mask(inode->i_mapping), NULL, fault_type);
 }
 
 static inline struct shmem_sb_info *SHMEM_SB(struct super_block *sb)
@@ -148,6 +149,12 @@ static inline int shmem_acct_block(unsigned long flags)
 		security_vm_enough_memory_kern(VM_ACCT(PAGE_CACHE_SIZE)) : 0;
 }
 
+static inline int shmem_acct_blocks(unsigned long flags, long pages)
+{
+	return (flags & VM_NORESERVE) ?
+		security_vm_enough_memory_kern(pages * VM_ACCT(PAGE_CACHE_SIZE)) : 0;
+}
+
 static inline void shmem_unacct_blocks(unsigned long flags, long pages)
 {
 	if (flags & VM_NORESERVE)
@@ -861,15 +868,232 @@ static inline struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
 }
 #endif
 
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+/* Huge extent policy of the internal mount, and the deny override */
+int shmem_huge __read_mostly;
+
+int shmem_parse_huge(const char *str)
+{
+	if (!strcmp(str, "never"))
+		return SHMEM_HUGE_NEVER;
+	if (!strcmp(str, "within_size"))
+		return SHMEM_HUGE_WITHIN_SIZE;
+	if (!strcmp(str, "advise"))
+		return SHMEM_HUGE_ADVISE;
+	if (!strcmp(str, "deny"))
+		return SHMEM_HUGE_DENY;
+	return -EINVAL;
+}
+
+const char *shmem_format_huge(int huge)
+{
+	switch (huge) {
+	case SHMEM_HUGE_NEVER:
+		return "never";
+	case SHMEM_HUGE_WITHIN_SIZE:
+		return "within_size";
+	case SHMEM_HUGE_ADVISE:
+		return "advise";
+	case SHMEM_HUGE_DENY:
+		return "deny";
+	default:
+		VM_BUG_ON(1);
+		return "bad_val";
+	}
+}
+
+/*
+ * Should a new page at @index come from a huge extent?  @vma is the
+ * mapping being faulted, if any: it is needed for huge=advise.
+ */
+static bool shmem_huge_allowed(struct inode *inode, pgoff_t index,
+			       struct vm_area_struct *vma)
+{
+	int huge = SHMEM_SB(inode->i_sb)->huge;
+	loff_t i_size;
+
+	if (shmem_huge == SHMEM_HUGE_DENY)
+		return false;
+	if (vma && (vma->vm_flags & VM_NOHUGEPAGE))
+		return false;
+	if (shm_mnt && inode->i_sb == shm_mnt->mnt_sb)
+		huge = shmem_huge;
+
+	switch (huge) {
+	case SHMEM_HUGE_WITHIN_SIZE:
+		index = round_up(index + 1, HPAGE_PMD_NR);
+		i_size = round_up(i_size_read(inode), PAGE_CACHE_SIZE);
+		return (i_size >> PAGE_CACHE_SHIFT) >= index;
+	case SHMEM_HUGE_ADVISE:
+		return vma && (vma->vm_flags & VM_HUGEPAGE);
+	default:
+		return false;
+	}
+}
+
+static struct page *shmem_alloc_hugepage(gfp_t gfp,
+			struct shmem_inode_info *info, pgoff_t hindex)
+{
+#ifdef CONFIG_NUMA
+	struct vm_area_struct pvma;
+	struct page *page;
+
+	/* Create a pseudo vma that just contains the policy */
+	pvma.vm_start = 0;
+	pvma.vm_pgoff = hindex;
+	pvma.vm_ops = NULL;
+	pvma.vm_policy = mpol_shared_policy_lookup(&info->policy, hindex);
+
+	page = alloc_pages_vma(gfp, HPAGE_PMD_ORDER, &pvma, 0, numa_node_id());
+
+	/* Drop reference taken by mpol_shared_policy_lookup() */
+	mpol_cond_put(pvma.vm_policy);
+
+	return page;
+#else
+	return alloc_pages(gfp, HPAGE_PMD_ORDER);
+#endif
+}
+
+/* Is any index of the huge extent starting at @hindex already in use? */
+static bool shmem_huge_extent_busy(struct address_space *mapping,
+				   pgoff_t hindex)
+{
+	void **slot;
+	unsigned long found;
+
+	rcu_read_lock();
+	if (!radix_tree_gang_lookup_slot(&mapping->page_tree, &slot, &found,
+					 hindex, 1))
+		found = hindex + HPAGE_PMD_NR;
+	rcu_read_unlock();
+
+	return found < hindex + HPAGE_PMD_NR;
+}
+
+/*
+ * Populate the whole naturally aligned HPAGE_PMD_SIZE extent around @index
+ * from a single huge page allocation, so that the extent is physically
+ * contiguous.  The block is split straight away: every page of it is then
+ * accounted, charged, reclaimed and truncated as an ordinary shmem page,
+ * so truncating or punching a hole in the extent simply splits it.
+ *
+ * Returns the page for @index locked, or NULL if the caller should fall
+ * back to allocating a single page.
+ */
+static struct page *shmem_alloc_huge_extent(struct inode *inode,
+					    pgoff_t index, gfp_t gfp)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	struct shmem_sb_info *sbinfo = SHMEM_SB(inode->i_sb);
+	pgoff_t hindex = round_down(index, HPAGE_PMD_NR);
+	DECLARE_BITMAP(added, HPAGE_PMD_NR);
+	struct page *head, *page, *ret = NULL;
+	int i, nr_added = 0;
+
+	if (hindex + HPAGE_PMD_NR - 1 > (MAX_LFS_FILESIZE >> PAGE_CACHE_SHIFT))
+		return NULL;
+	if (shmem_huge_extent_busy(mapping, hindex))
+		return NULL;
+
+	if (shmem_acct_blocks(info->flags, HPAGE_PMD_NR))
+		goto fallback;
+	if (sbinfo->max_blocks) {
+		if (sbinfo->max_blocks < HPAGE_PMD_NR ||
+		    percpu_counter_compare(&sbinfo->used_blocks,
+				sbinfo->max_blocks - HPAGE_PMD_NR) > 0)
+			goto unacct;
+		percpu_counter_add(&sbinfo->used_blocks, HPAGE_PMD_NR);
+	}
+
+	head = shmem_alloc_hugepage(gfp | __GFP_NORETRY | __GFP_NOWARN |
+				    __GFP_NO_KSWAPD, info, hindex);
+	if (!head)
+		goto decused;
+	split_page(head, HPAGE_PMD_ORDER);
+
+	bitmap_zero(added, HPAGE_PMD_NR);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		page = head + i;
+		clear_highpage(page);
+		flush_dcache_page(page);
+		SetPageUptodate(page);
+		SetPageSwapBacked(page);
+		__set_page_locked(page);
+		/* A concurrent fault may have beaten us to some index */
+		if (mem_cgroup_cache_charge(page, current->mm,
+					    gfp & GFP_RECLAIM_MASK))
+			continue;
+		if (shmem_add_to_page_cache(page, mapping, hindex + i,
+					    gfp, NULL))
+			continue;
+		__set_bit(i, added);
+		nr_added++;
+	}
+
+	spin_lock(&info->lock);
+	info->alloced += nr_added;
+	inode->i_blocks += BLOCKS_PER_PAGE * nr_added;
+	shmem_recalc_inode(inode);
+	spin_unlock(&info->lock);
+
+	if (nr_added < HPAGE_PMD_NR) {
+		if (sbinfo->max_blocks)
+			percpu_counter_add(&sbinfo->used_blocks,
+					   nr_added - HPAGE_PMD_NR);
+		shmem_unacct_blocks(info->flags, HPAGE_PMD_NR - nr_added);
+	}
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		page = head + i;
+		if (test_bit(i, added)) {
+			lru_cache_add_anon(page);
+			if (hindex + i == index) {
+				ret = page;
+				continue;
+			}
+		}
+		unlock_page(page);
+		page_cache_release(page);
+	}
+	count_vm_event(THP_FILE_ALLOC);
+	return ret;
+
+decused:
+	if (sbinfo->max_blocks)
+		percpu_counter_add(&sbinfo->used_blocks, -HPAGE_PMD_NR);
+unacct:
+	shmem_unacct_blocks(info->flags, HPAGE_PMD_NR);
+fallback:
+	count_vm_event(THP_FILE_FALLBACK);
+	return NULL;
+}
+#else /* !CONFIG_TRANSPARENT_HUGE_PAGECACHE */
+static inline bool shmem_huge_allowed(struct inode *inode, pgoff_t index,
+				      struct vm_area_struct *vma)
+{
+	return false;
+}
+
+static inline struct page *shmem_alloc_huge_extent(struct inode *inode,
+						   pgoff_t index, gfp_t gfp)
+{
+	return NULL;
+}
+#endif /* CONFIG_TRANSPARENT_HUGE_PAGECACHE */
+
 /*
  * shmem_getpage_gfp - find page in cache, or get from swap, or allocate
  *
  * If we allocate a new one we do not mark it dirty. That's up to the
  * vm. If we swap it in we mark it dirty since we also free the swap
- * entry since a page cannot live in both the swap and page cache
+ * entry since a page cannot live in both the swap and page cache.
+ * @vma is the mapping being faulted, or NULL for read, write and splice.
  */
 static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
-	struct page **pagep, enum sgp_type sgp, gfp_t gfp, int *fault_type)
+	struct page **pagep, enum sgp_type sgp, gfp_t gfp,
+	struct vm_area_struct *vma, int *fault_type)
 {
 	struct address_space *mapping = inode->i_mapping;
 	struct shmem_inode_info *info;
@@ -962,6 +1186,15 @@ repeat:
 		swap_free(swap);
 
 	} else {
+		if (shmem_huge_allowed(inode, index, vma)) {
+			page = shmem_alloc_huge_extent(inode, index, gfp);
+			if (page) {
+				if (sgp == SGP_DIRTY)
+					set_page_dirty(page);
+				goto done;
+			}
+		}
+
 		if (shmem_acct_block(info->flags)) {
 			error = -ENOSPC;
 			goto failed;
@@ -1060,7 +1293,8 @@ static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	int error;
 	int ret = VM_FAULT_LOCKED;
 
-	error = shmem_getpage(inode, vmf->pgoff, &vmf->page, SGP_CACHE, &ret);
+	error = shmem_getpage_gfp(inode, vmf->pgoff, &vmf->page, SGP_CACHE,
+			mapping_gfp_mask(inode->i_mapping), vma, &ret);
 	if (error)
 		return ((error == -ENOMEM) ? VM_FAULT_OOM : VM_FAULT_SIGBUS);
 
@@ -2099,6 +2333,20 @@ static int shmem_parse_options(char *options, struct shmem_sb_info *sbinfo,
 		} else if (!strcmp(this_char,"mpol")) {
 			if (mpol_parse_str(value, &sbinfo->mpol, 1))
 				goto bad_val;
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+		} else if (!strcmp(this_char,"huge")) {
+			int huge = shmem_parse_huge(value);
+			/* deny is for shmem_enabled only */
+			if (!strcmp(value, "always")) {
+				printk(KERN_ERR "tmpfs: huge=always is not "
+				       "supported, extents are not mapped by "
+				       "huge pmds\n");
+				return 1;
+			}
+			if (huge < 0)
+				goto bad_val;
+			sbinfo->huge = huge;
+#endif
 		} else {
 			printk(KERN_ERR "tmpfs: Bad mount option %s\n",
 			       this_char);
@@ -2145,6 +2393,7 @@ static int shmem_remount_fs(struct super_block *sb, int *flags, char *data)
 	sbinfo->max_blocks  = config.max_blocks;
 	sbinfo->max_inodes  = config.max_inodes;
 	sbinfo->free_inodes = config.max_inodes - inodes;
+	sbinfo->huge = config.huge;
 
 	/*
 	 * Preserve previous mempolicy unless mpol remount option was specified.
@@ -2173,6 +2422,10 @@ static int shmem_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_printf(seq, ",uid=%u", sbinfo->uid);
 	if (sbinfo->gid != 0)
 		seq_printf(seq, ",gid=%u", sbinfo->gid);
+#ifdef CONFIG_TRANSPARENT_HUGE_PAGECACHE
+	if (sbinfo->huge)
+		seq_printf(seq, ",huge=%s", shmem_format_huge(sbinfo->huge));
+#endif
 	shmem_show_mpol(seq, sbinfo->mpol);
 	return 0;
 }
@@ -2615,7 +2868,8 @@ struct page *shmem_read_mapping_page_gfp(struct address_space *mapping,
 	int error;
 
 	BUG_ON(mapping->a_ops != &shmem_aops);
-	error = shmem_getpage_gfp(inode, index, &page, SGP_CACHE, gfp, NULL);
+	error = shmem_getpage_gfp(inode, index, &page, SGP_CACHE, gfp,
+				  NULL, NULL);
 	if (error)
 		page = ERR_PTR(error);
 	else
@@ -2002,6 +2002,8 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	deactivate_slab(s, c);
 }
 
+static void flush_remote_frees(struct kmem_cache *s, struct kmem_cache_cpu *c);
+
 /*
  * Flush cpu slab.
  *
@@ -2012,6 +2014,9 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
 	if (likely(c)) {
+		if (c->nr_remote)
+			flush_remote_frees(s, c);
+
 		if (c->page)
 			flush_slab(s, c);
 
@@ -2403,12 +2408,15 @@ EXPORT_SYMBOL(kmem_cache_alloc_node_trace);
  * So we still attempt to reduce cache line usage. Just take the slab
  * lock and free the item. If there is no additional partial page
  * handling required then we can return immediately.
+ *
+ * head and tail delimit a list of cnt objects of the same slab page that
+ * are linked through their free pointers. They are returned to the slab
+ * with a single cmpxchg. Debug caches always free a single object.
  */
 static void __slab_free(struct kmem_cache *s, struct page *page,
-			void *x, unsigned long addr)
+			void *head, void *tail, int cnt, unsigned long addr)
 {
 	void *prior;
-	void **object = (void *)x;
 	int was_frozen;
 	int inuse;
 	struct page new;
@@ -2418,16 +2426,16 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 	stat(s, FREE_SLOWPATH);
 
-	if (kmem_cache_debug(s) && !free_debug_processing(s, page, x, addr))
+	if (kmem_cache_debug(s) && !free_debug_processing(s, page, head, addr))
 		return;
 
 	do {
 		prior = page->freelist;
 		counters = page->counters;
-		set_freepointer(s, object, prior);
+		set_freepointer(s, tail, prior);
 		new.counters = counters;
 		was_frozen = new.frozen;
-		new.inuse--;
+		new.inuse -= cnt;
 		if ((!new.inuse || !prior) && !was_frozen && !n) {
 
 			if (!kmem_cache_debug(s) && !prior)
@@ -2457,7 +2465,7 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 	} while (!cmpxchg_double_slab(s, page,
 		prior, counters,
-		object, new.counters,
+		head, new.counters,
 		"__slab_free"));
 
 	if (likely(!n)) {
@@ -2518,24 +2526,129 @@ slab_empty:
 }
 
 /*
- * Fastpath with forced inlining to produce a kfree and kmem_cache_free that
- * can perform fastpath freeing without additional function calls.
- *
- * The fastpath is only possible if we are freeing to the current cpu slab
- * of this processor. This typically the case if we have just allocated
- * the item before.
+ * A detached freelist is a list of objects of one slab page, linked
+ * through their free pointers, that can be handed to the page at once.
+ */
+struct detached_freelist {
+	struct page *page;
+	void *head;
+	void *tail;
+	int cnt;
+};
+
+/*
+ * Collect objects from the end of the array p that belong to the same
+ * slab page as the last object into df. Consumed entries are set to NULL.
+ * The scan gives up after a few objects of other pages have been seen.
+ * Returns the number of array entries that still need to be looked at.
+ */
+static int build_detached_freelist(struct kmem_cache *s, size_t size,
+				   void **p, struct detached_freelist *df)
+{
+	size_t first_skipped = 0;
+	int lookahead = 3;
+	void *object;
+
+	df->page = NULL;
+
+	do {
+		object = p[--size];
+	} while (!object && size);
+
+	if (!object)
+		return 0;
+
+	set_freepointer(s, object, NULL);
+	df->page = virt_to_head_page(object);
+	df->head = df->tail = object;
+	df->cnt = 1;
+	p[size] = NULL;
+
+	while (size) {
+		object = p[--size];
+		if (!object)
+			continue;
+
+		if (virt_to_head_page(object) == df->page) {
+			set_freepointer(s, object, df->head);
+			df->head = object;
+			df->cnt++;
+			p[size] = NULL;
+			continue;
+		}
+
+		if (!--lookahead)
+			break;
+
+		if (!first_skipped)
+			first_skipped = size + 1;
+	}
+
+	return first_skipped;
+}
+
+/*
+ * Return the objects collected in the remote free magazine of a cpu to
+ * their slabs. Objects of the same slab page are freed together, so each
+ * remote slab page is touched once per flush instead of once per object.
  *
- * If fastpath is not possible then fall back to __slab_free where we deal
- * with all sorts of special processing.
+ * Called with interrupts disabled.
  */
-static __always_inline void slab_free(struct kmem_cache *s,
-			struct page *page, void *x, unsigned long addr)
+static void flush_remote_frees(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct detached_freelist df;
+	int nr = c->nr_remote;
+
+	c->nr_remote = 0;
+	stat(s, REMOTE_BATCH_FLUSH);
+
+	/* Debug checks may have been switched on since the objects came in */
+	if (unlikely(kmem_cache_debug(s))) {
+		while (nr--)
+			__slab_free(s, virt_to_head_page(c->remote[nr]),
+				    c->remote[nr], c->remote[nr], 1, _RET_IP_);
+		return;
+	}
+
+	while (nr) {
+		nr = build_detached_freelist(s, nr, c->remote, &df);
+		if (df.page)
+			__slab_free(s, df.page, df.head, df.tail, df.cnt,
+				    _RET_IP_);
+	}
+}
+
+/*
+ * An object that does not belong to the cpu slab is usually freed on a
+ * different cpu than the one that allocated it. Instead of updating the
+ * (cache cold) slab page right away, park the object in a small per cpu
+ * magazine and return a whole batch to the slabs at once.
+ */
+static void slab_free_remote(struct kmem_cache *s, void *x)
 {
-	void **object = (void *)x;
 	struct kmem_cache_cpu *c;
-	unsigned long tid;
+	unsigned long flags;
 
-	slab_free_hook(s, x);
+	local_irq_save(flags);
+	c = __this_cpu_ptr(s->cpu_slab);
+	c->remote[c->nr_remote++] = x;
+	stat(s, FREE_REMOTE_BATCH);
+	if (c->nr_remote >= s->remote_batch)
+		flush_remote_frees(s, c);
+	local_irq_restore(flags);
+}
+
+/*
+ * Free a list of cnt objects of one slab page, linked from head to tail.
+ * Single objects freed to a slab other than the cpu slab are batched in
+ * the remote free magazine if the cache allows it.
+ */
+static __always_inline void do_slab_free(struct kmem_cache *s,
+			struct page *page, void *head, void *tail, int cnt,
+			unsigned long addr)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long tid;
 
 redo:
 	/*
@@ -2550,20 +2663,39 @@ redo:
 	barrier();
 
 	if (likely(page == c->page)) {
-		set_freepointer(s, object, c->freelist);
+		set_freepointer(s, tail, c->freelist);
 
 		if (unlikely(!irqsafe_cpu_cmpxchg_double(
 				s->cpu_slab->freelist, s->cpu_slab->tid,
 				c->freelist, tid,
-				object, next_tid(tid)))) {
+				head, next_tid(tid)))) {
 
 			note_cmpxchg_failure("slab_free", s, tid);
 			goto redo;
 		}
 		stat(s, FREE_FASTPATH);
-	} else
-		__slab_free(s, page, x, addr);
+	} else if (cnt == 1 && s->remote_batch && !kmem_cache_debug(s))
+		slab_free_remote(s, head);
+	else
+		__slab_free(s, page, head, tail, cnt, addr);
+}
 
+/*
+ * Fastpath with forced inlining to produce a kfree and kmem_cache_free that
+ * can perform fastpath freeing without additional function calls.
+ *
+ * The fastpath is only possible if we are freeing to the current cpu slab
+ * of this processor. This typically the case if we have just allocated
+ * the item before.
+ *
+ * If fastpath is not possible then fall back to __slab_free where we deal
+ * with all sorts of special processing.
+ */
+static __always_inline void slab_free(struct kmem_cache *s,
+			struct page *page, void *x, unsigned long addr)
+{
+	slab_free_hook(s, x);
+	do_slab_free(s, page, x, x, 1, addr);
 }
 
 void kmem_cache_free(struct kmem_cache *s, void *x)
@@ -2578,6 +2710,109 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_free_bulk - free an array of objects
+ * @s: the cache the objects belong to
+ * @size: number of entries in @p
+ * @p: the objects; NULL entries are skipped, the array is clobbered
+ *
+ * Objects are grouped by slab page and each group is returned with a
+ * single operation on the page (or on the cpu freelist).
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	struct detached_freelist df;
+	size_t i;
+
+	if (unlikely(!size))
+		return;
+
+	for (i = 0; i < size; i++) {
+		if (!p[i])
+			continue;
+		slab_free_hook(s, p[i]);
+		trace_kmem_cache_free(_RET_IP_, p[i]);
+		if (unlikely(kmem_cache_debug(s))) {
+			__slab_free(s, virt_to_head_page(p[i]), p[i], p[i], 1,
+				    _RET_IP_);
+			p[i] = NULL;
+		}
+	}
+
+	do {
+		size = build_detached_freelist(s, size, p, &df);
+		if (df.page)
+			do_slab_free(s, df.page, df.head, df.tail, df.cnt,
+				     _RET_IP_);
+	} while (size);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+/**
+ * kmem_cache_alloc_bulk - allocate an array of objects
+ * @s: the cache to allocate from
+ * @flags: allocation flags
+ * @size: number of objects to allocate
+ * @p: array receiving the objects
+ *
+ * Objects are taken straight off the cpu freelist with interrupts disabled,
+ * refilling it through the slow path as needed. Returns @size on success
+ * or 0 if not all objects could be allocated; nothing is allocated then.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	size_t i;
+
+	if (slab_pre_alloc_hook(s, flags))
+		return 0;
+
+	local_irq_disable();
+	c = __this_cpu_ptr(s->cpu_slab);
+
+	for (i = 0; i < size; i++) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			/* __slab_alloc() may enable interrupts to grow the cache */
+			p[i] = __slab_alloc(s, flags, NUMA_NO_NODE, _RET_IP_, c);
+			if (unlikely(!p[i]))
+				goto error;
+
+			c = __this_cpu_ptr(s->cpu_slab);
+			continue;
+		}
+		c->freelist = get_freepointer(s, object);
+		p[i] = object;
+		stat(s, ALLOC_FASTPATH);
+	}
+	/* Make preempted fastpath cmpxchgs on this cpu fail */
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+
+	for (i = 0; i < size; i++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[i], 0, s->objsize);
+		slab_post_alloc_hook(s, flags, p[i]);
+		trace_kmem_cache_alloc(_RET_IP_, p[i], s->objsize, s->size,
+				       flags);
+	}
+	return size;
+
+error:
+	c = __this_cpu_ptr(s->cpu_slab);
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+
+	while (i--) {
+		slab_post_alloc_hook(s, flags, p[i]);
+		slab_free(s, virt_to_head_page(p[i]), p[i], _RET_IP_);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /*
  * Object placement in a slab is made very easy because we always start at
  * offset 0. If we tune the size of the object to the alignment then we can
@@ -3055,6 +3290,16 @@ static int kmem_cache_open(struct kmem_cache *s,
 	else
 		s->cpu_partial = 30;
 
+	/*
+	 * Frees to slabs other than the cpu slab are collected per cpu and
+	 * returned in batches of remote_batch objects. Debug caches check
+	 * every object as it is freed and do not batch.
+	 */
+	if (kmem_cache_debug(s))
+		s->remote_batch = 0;
+	else
+		s->remote_batch = SLUB_REMOTE_BATCH;
+
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -4660,6 +4905,29 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+static ssize_t remote_batch_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->remote_batch);
+}
+
+static ssize_t remote_batch_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long objects;
+	int err;
+
+	err = strict_strtoul(buf, 10, &objects);
+	if (err)
+		return err;
+	if (objects > SLUB_REMOTE_BATCH || (objects && kmem_cache_debug(s)))
+		return -EINVAL;
+
+	s->remote_batch = objects;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(remote_batch);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5053,6 +5321,8 @@ STAT_ATTR(CMPXCHG_DOUBLE_CPU_FAIL, cmpxchg_double_cpu_fail);
 STAT_ATTR(CMPXCHG_DOUBLE_FAIL, cmpxchg_double_fail);
 STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(FREE_REMOTE_BATCH, free_remote_batch);
+STAT_ATTR(REMOTE_BATCH_FLUSH, remote_batch_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -5062,6 +5332,7 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+	&remote_batch_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -5118,6 +5389,8 @@ static struct attribute *slab_attrs[] = {
 	&cmpxchg_double_cpu_fail_attr.attr,
 	&cpu_partial_alloc_attr.attr,
 	&cpu_partial_free_attr.attr,
+	&free_remote_batch_attr.attr,
+	&remote_batch_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -24,6 +24,7 @@
 #include <linux/rbtree.h>
 #include <linux/radix-tree.h>
 #include <linux/rcupdate.h>
+#include <linux/llist.h>
 #include <linux/pfn.h>
 #include <linux/kmemleak.h>
 #include <linux/atomic.h>
@@ -255,23 +256,26 @@ struct vmap_area {
 	unsigned long flags;
 	struct rb_node rb_node;		/* address sorted rbtree */
 	struct list_head list;		/* address sorted list */
-	struct list_head purge_list;	/* "lazy purge" list */
+	struct llist_node purge_list;	/* "lazy purge" list */
+	struct list_head cache_list;	/* per cpu cache of free areas */
 	struct vm_struct *vm;
 	struct rcu_head rcu_head;
+	unsigned long hole;		/* free space below va_start */
+	unsigned long subtree_max_hole;	/* largest hole in rb subtree */
+	int cpu;			/* CPU which freed the area */
 };
 
 static DEFINE_SPINLOCK(vmap_area_lock);
 static LIST_HEAD(vmap_area_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 
-/* The vmap cache globals are protected by vmap_area_lock */
-static struct rb_node *free_vmap_cache;
-static unsigned long cached_hole_size;
-static unsigned long cached_vstart;
-static unsigned long cached_align;
+/* Lazily freed areas waiting for a TLB flush, see free_vmap_area_noflush */
+static LLIST_HEAD(vmap_purge_list);
 
 static unsigned long vmap_area_pcpu_hole;
 
+static bool vmap_initialized __read_mostly = false;
+
 static struct vmap_area *__find_vmap_area(unsigned long addr)
 {
 	struct rb_node *n = vmap_area_root.rb_node;
@@ -291,6 +295,41 @@ static struct vmap_area *__find_vmap_area(unsigned long addr)
 	return NULL;
 }
 
+/*
+ * The busy area rbtree is augmented with the size of the free hole below
+ * each area, and each node caches the largest such hole in its subtree.
+ * This lets alloc_vmap_area find the lowest suitable hole in O(log n)
+ * instead of walking the areas one by one.
+ */
+static inline unsigned long vmap_area_subtree_hole(struct rb_node *node)
+{
+	if (!node)
+		return 0;
+	return rb_entry(node, struct vmap_area, rb_node)->subtree_max_hole;
+}
+
+static void vmap_area_augment_cb(struct rb_node *node, void *unused)
+{
+	struct vmap_area *va = rb_entry(node, struct vmap_area, rb_node);
+	unsigned long max_hole = va->hole;
+
+	max_hole = max(max_hole, vmap_area_subtree_hole(node->rb_left));
+	max_hole = max(max_hole, vmap_area_subtree_hole(node->rb_right));
+	va->subtree_max_hole = max_hole;
+}
+
+/* Set the hole below @va and fix up the subtree maxima above it */
+static void vmap_area_set_hole(struct vmap_area *va, unsigned long prev_end)
+{
+	struct rb_node *node = &va->rb_node;
+
+	va->hole = va->va_start - prev_end;
+	do {
+		vmap_area_augment_cb(node, NULL);
+		node = rb_parent(node);
+	} while (node);
+}
+
 static void __insert_vmap_area(struct vmap_area *va)
 {
 	struct rb_node **p = &vmap_area_root.rb_node;
@@ -319,8 +358,164 @@ static void __insert_vmap_area(struct vmap_area *va)
 		struct vmap_area *prev;
 		prev = rb_entry(tmp, struct vmap_area, rb_node);
 		list_add_rcu(&va->list, &prev->list);
-	} else
+		va->hole = va->va_start - prev->va_end;
+	} else {
 		list_add_rcu(&va->list, &vmap_area_list);
+		va->hole = va->va_start;
+	}
+	rb_augment_insert(&va->rb_node, vmap_area_augment_cb, NULL);
+
+	/* The new area splits the hole below its successor */
+	tmp = rb_next(&va->rb_node);
+	if (tmp)
+		vmap_area_set_hole(rb_entry(tmp, struct vmap_area, rb_node),
+				   va->va_end);
+}
+
+/*
+ * Can an area of @size bytes aligned to @align be placed in the hole below
+ * @va, at or above @vstart? If so, return its address in *@addr.
+ */
+static bool vmap_hole_fits(struct vmap_area *va, unsigned long size,
+			   unsigned long align, unsigned long vstart,
+			   unsigned long *addr)
+{
+	unsigned long start = va->va_start - va->hole;
+
+	if (start < vstart)
+		start = vstart;
+	*addr = ALIGN(start, align);
+	if (*addr < start || *addr + size < *addr)
+		return false;
+
+	return *addr + size <= va->va_start;
+}
+
+/*
+ * Find the lowest hole at or above @vstart that fits the request. This is
+ * an in-order walk of the rbtree that skips every subtree whose largest
+ * hole is too small, and every left subtree that lies entirely below
+ * @vstart. Holes above the last area are not considered.
+ */
+static struct vmap_area *find_vmap_lowest_hole(unsigned long size,
+				unsigned long align, unsigned long vstart,
+				unsigned long *addr)
+{
+	struct rb_node *n = vmap_area_root.rb_node;
+	struct vmap_area *va;
+
+	while (n) {
+		va = rb_entry(n, struct vmap_area, rb_node);
+		if (va->va_start > vstart &&
+		    vmap_area_subtree_hole(n->rb_left) >= size) {
+			n = n->rb_left;
+			continue;
+		}
+
+		for (;;) {
+			struct rb_node *parent;
+
+			if (vmap_hole_fits(va, size, align, vstart, addr))
+				return va;
+
+			if (vmap_area_subtree_hole(n->rb_right) >= size) {
+				n = n->rb_right;
+				break;
+			}
+
+			/* Go up until we return from a left subtree */
+			while ((parent = rb_parent(n)) && n == parent->rb_right)
+				n = parent;
+			if (!parent)
+				return NULL;
+			n = parent;
+			va = rb_entry(n, struct vmap_area, rb_node);
+		}
+	}
+
+	return NULL;
+}
+
+/*** Per cpu cache of free kva ***/
+
+/*
+ * Small areas freed through the lazy purge path are not returned to the
+ * rbtree but parked in a cache of the CPU that freed them, so that the
+ * next vmalloc of the same size on that CPU can be served without taking
+ * vmap_area_lock at all. Cached areas stay in the rbtree (they are already
+ * unmapped and flushed from the TLB), which is why the cache is bounded
+ * and is drained before an allocation is allowed to fail.
+ */
+#define VMAP_CACHE_MAX_PAGES	16
+#if BITS_PER_LONG == 32
+#define VMAP_CACHE_CPU_PAGES	64
+#else
+#define VMAP_CACHE_CPU_PAGES	1024
+#endif
+
+struct vmap_area_cache {
+	spinlock_t lock;
+	unsigned long nr_pages;
+	struct list_head free[VMAP_CACHE_MAX_PAGES];
+};
+
+static DEFINE_PER_CPU(struct vmap_area_cache, vmap_area_cache);
+
+static struct vmap_area *vmap_area_cache_get(unsigned long size,
+				unsigned long align,
+				unsigned long vstart, unsigned long vend)
+{
+	unsigned long nr = size >> PAGE_SHIFT;
+	struct vmap_area_cache *cache;
+	struct vmap_area *va = NULL;
+
+	if (nr > VMAP_CACHE_MAX_PAGES || unlikely(!vmap_initialized))
+		return NULL;
+
+	cache = &per_cpu(vmap_area_cache, raw_smp_processor_id());
+	if (!cache->nr_pages)
+		return NULL;
+
+	spin_lock(&cache->lock);
+	if (!list_empty(&cache->free[nr - 1])) {
+		va = list_first_entry(&cache->free[nr - 1],
+				      struct vmap_area, cache_list);
+		if (va->va_start >= vstart && va->va_end <= vend &&
+		    IS_ALIGNED(va->va_start, align)) {
+			list_del(&va->cache_list);
+			cache->nr_pages -= nr;
+			va->flags = 0;
+		} else
+			va = NULL;
+	}
+	spin_unlock(&cache->lock);
+
+	return va;
+}
+
+static bool vmap_area_cache_put(struct vmap_area *va)
+{
+	unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
+	struct vmap_area_cache *cache;
+	bool cached = false;
+
+	if (nr > VMAP_CACHE_MAX_PAGES ||
+	    va->va_start < VMALLOC_START || va->va_end > VMALLOC_END)
+		return false;
+
+	cache = &per_cpu(vmap_area_cache, va->cpu);
+	spin_lock(&cache->lock);
+	if (cache->nr_pages + nr <= VMAP_CACHE_CPU_PAGES) {
+		/* A stale vfree of this address must not find a vm_struct */
+		va->flags = VM_LAZY_FREEING;
+		va->vm = NULL;
+		list_add(&va->cache_list, &cache->free[nr - 1]);
+		cache->nr_pages += nr;
+		cached = true;
+	}
+	spin_unlock(&cache->lock);
+
+	return cached;
 }
 
 static void purge_vmap_area_lazy(void);
@@ -338,12 +533,15 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	struct rb_node *n;
 	unsigned long addr;
 	int purged = 0;
-	struct vmap_area *first;
 
 	BUG_ON(!size);
 	BUG_ON(size & ~PAGE_MASK);
 	BUG_ON(!is_power_of_2(align));
 
+	va = vmap_area_cache_get(size, align, vstart, vend);
+	if (va)
+		return va;
+
 	va = kmalloc_node(sizeof(struct vmap_area),
 			gfp_mask & GFP_RECLAIM_MASK, node);
 	if (unlikely(!va))
@@ -351,76 +549,23 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 
 retry:
 	spin_lock(&vmap_area_lock);
-	/*
-	 * Invalidate cache if we have more permissive parameters.
-	 * cached_hole_size notes the largest hole noticed _below_
-	 * the vmap_area cached in free_vmap_cache: if size fits
-	 * into that hole, we want to scan from vstart to reuse
-	 * the hole instead of allocating above free_vmap_cache.
-	 * Note that __free_vmap_area may update free_vmap_cache
-	 * without updating cached_hole_size or cached_align.
-	 */
-	if (!free_vmap_cache ||
-			size < cached_hole_size ||
-			vstart < cached_vstart ||
-			align < cached_align) {
-nocache:
-		cached_hole_size = 0;
-		free_vmap_cache = NULL;
-	}
-	/* record if we encounter less permissive parameters */
-	cached_vstart = vstart;
-	cached_align = align;
-
-	/* find starting point for our search */
-	if (free_vmap_cache) {
-		first = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-		addr = ALIGN(first->va_end, align);
-		if (addr < vstart)
-			goto nocache;
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-	} else {
-		addr = ALIGN(vstart, align);
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-		n = vmap_area_root.rb_node;
-		first = NULL;
-
-		while (n) {
-			struct vmap_area *tmp;
-			tmp = rb_entry(n, struct vmap_area, rb_node);
-			if (tmp->va_end >= addr) {
-				first = tmp;
-				if (tmp->va_start <= addr)
-					break;
-				n = n->rb_left;
-			} else
-				n = n->rb_right;
+	if (!find_vmap_lowest_hole(size, align, vstart, &addr)) {
+		/* No hole fits, try above the last area */
+		addr = vstart;
+		n = rb_last(&vmap_area_root);
+		if (n) {
+			struct vmap_area *last;
+
+			last = rb_entry(n, struct vmap_area, rb_node);
+			addr = max(addr, last->va_end);
 		}
-
-		if (!first)
-			goto found;
-	}
-
-	/* from the starting point, walk areas until a suitable hole is found */
-	while (addr + size > first->va_start && addr + size <= vend) {
-		if (addr + cached_hole_size < first->va_start)
-			cached_hole_size = first->va_start - addr;
-		addr = ALIGN(first->va_end, align);
-		if (addr + size - 1 < addr)
+		if (ALIGN(addr, align) < addr)
 			goto overflow;
-
-		n = rb_next(&first->rb_node);
-		if (n)
-			first = rb_entry(n, struct vmap_area, rb_node);
-		else
-			goto found;
+		addr = ALIGN(addr, align);
 	}
 
-found:
+	if (addr + size - 1 < addr)
+		goto overflow;
 	if (addr + size > vend)
 		goto overflow;
 
@@ -428,7 +573,6 @@ found:
 	va->va_end = addr + size;
 	va->flags = 0;
 	__insert_vmap_area(va);
-	free_vmap_cache = &va->rb_node;
 	spin_unlock(&vmap_area_lock);
 
 	BUG_ON(va->va_start & (align-1));
@@ -454,27 +598,24 @@ overflow:
 
 static void __free_vmap_area(struct vmap_area *va)
 {
+	struct rb_node *prev, *next, *deepest;
+
 	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
 
-	if (free_vmap_cache) {
-		if (va->va_end < cached_vstart) {
-			free_vmap_cache = NULL;
-		} else {
-			struct vmap_area *cache;
-			cache = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-			if (va->va_start <= cache->va_start) {
-				free_vmap_cache = rb_prev(&va->rb_node);
-				/*
-				 * We don't try to update cached_hole_size or
-				 * cached_align, but it won't go very wrong.
-				 */
-			}
-		}
-	}
+	prev = rb_prev(&va->rb_node);
+	next = rb_next(&va->rb_node);
+
+	deepest = rb_augment_erase_begin(&va->rb_node);
 	rb_erase(&va->rb_node, &vmap_area_root);
 	RB_CLEAR_NODE(&va->rb_node);
+	rb_augment_erase_end(deepest, vmap_area_augment_cb, NULL);
 	list_del_rcu(&va->list);
 
+	/* The freed range merges into the hole below the successor */
+	if (next)
+		vmap_area_set_hole(rb_entry(next, struct vmap_area, rb_node),
+			prev ? rb_entry(prev, struct vmap_area, rb_node)->va_end : 0);
+
 	/*
 	 * Track the highest possible candidate for pcpu area
 	 * allocation.  Areas outside of vmalloc area can be returned
@@ -568,6 +709,11 @@ void set_iounmap_nonlazy(void)
 /*
  * Purges all lazily-freed vmap areas.
  *
+ * Lazily freed areas are queued on the lock-less vmap_purge_list, so a
+ * purge only looks at the areas it is going to free, and all of them are
+ * covered by a single TLB flush. Small areas are then parked in the per
+ * cpu caches, the rest go back to the rbtree under one vmap_area_lock hold.
+ *
  * If sync is 0 then don't purge if there is already a purge in progress.
  * If force_flush is 1, then flush kernel TLBs between *start and *end even
  * if we found no lazy vmap areas to unmap (callers can use this to optimise
@@ -579,9 +725,8 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 					int sync, int force_flush)
 {
 	static DEFINE_SPINLOCK(purge_lock);
-	LIST_HEAD(valist);
+	struct llist_node *valist, *next;
 	struct vmap_area *va;
-	struct vmap_area *n_va;
 	int nr = 0;
 
 	/*
@@ -598,20 +743,16 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	if (sync)
 		purge_fragmented_blocks_allcpus();
 
-	rcu_read_lock();
-	list_for_each_entry_rcu(va, &vmap_area_list, list) {
-		if (va->flags & VM_LAZY_FREE) {
-			if (va->va_start < *start)
-				*start = va->va_start;
-			if (va->va_end > *end)
-				*end = va->va_end;
-			nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
-			list_add_tail(&va->purge_list, &valist);
-			va->flags |= VM_LAZY_FREEING;
-			va->flags &= ~VM_LAZY_FREE;
-		}
+	valist = llist_del_all(&vmap_purge_list);
+	llist_for_each_entry(va, valist, purge_list) {
+		if (va->va_start < *start)
+			*start = va->va_start;
+		if (va->va_end > *end)
+			*end = va->va_end;
+		nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
+		va->flags |= VM_LAZY_FREEING;
+		va->flags &= ~VM_LAZY_FREE;
 	}
-	rcu_read_unlock();
 
 	if (nr)
 		atomic_sub(nr, &vmap_lazy_nr);
@@ -620,14 +761,55 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 		flush_tlb_kernel_range(*start, *end);
 
 	if (nr) {
+		struct llist_node *tofree = NULL;
+
+		for (; valist; valist = next) {
+			next = valist->next;
+			va = llist_entry(valist, struct vmap_area, purge_list);
+			if (!vmap_area_cache_put(va)) {
+				valist->next = tofree;
+				tofree = valist;
+			}
+		}
+
 		spin_lock(&vmap_area_lock);
-		list_for_each_entry_safe(va, n_va, &valist, purge_list)
-			__free_vmap_area(va);
+		for (; tofree; tofree = next) {
+			next = tofree->next;
+			__free_vmap_area(llist_entry(tofree, struct vmap_area,
+						     purge_list));
+		}
 		spin_unlock(&vmap_area_lock);
 	}
 	spin_unlock(&purge_lock);
 }
 
+/*
+ * Return all areas in the per cpu caches to the rbtree, so that their
+ * address space can be used for requests of any size.
+ */
+static void vmap_area_cache_drain(void)
+{
+	struct vmap_area *va, *n_va;
+	int cpu, i;
+
+	spin_lock(&vmap_area_lock);
+	for_each_possible_cpu(cpu) {
+		struct vmap_area_cache *cache = &per_cpu(vmap_area_cache, cpu);
+
+		spin_lock(&cache->lock);
+		for (i = 0; i < VMAP_CACHE_MAX_PAGES; i++) {
+			list_for_each_entry_safe(va, n_va, &cache->free[i],
+						 cache_list) {
+				list_del(&va->cache_list);
+				__free_vmap_area(va);
+			}
+		}
+		cache->nr_pages = 0;
+		spin_unlock(&cache->lock);
+	}
+	spin_unlock(&vmap_area_lock);
+}
+
 /*
  * Kick off a purge of the outstanding lazy areas. Don't bother if somebody
  * is already purging.
@@ -640,13 +822,16 @@ static void try_purge_vmap_area_lazy(void)
 }
 
 /*
- * Kick off a purge of the outstanding lazy areas.
+ * Kick off a purge of the outstanding lazy areas, and release the per cpu
+ * caches. Used when an allocation could not find enough address space.
  */
 static void purge_vmap_area_lazy(void)
 {
 	unsigned long start = ULONG_MAX, end = 0;
 
 	__purge_vmap_area_lazy(&start, &end, 1, 0);
+	if (vmap_initialized)
+		vmap_area_cache_drain();
 }
 
 /*
@@ -657,6 +842,8 @@ static void purge_vmap_area_lazy(void)
 static void free_vmap_area_noflush(struct vmap_area *va)
 {
 	va->flags |= VM_LAZY_FREE;
+	va->cpu = raw_smp_processor_id();
+	llist_add(&va->purge_list, &vmap_purge_list);
 	atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT, &vmap_lazy_nr);
 	if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
 		try_purge_vmap_area_lazy();
@@ -732,8 +919,6 @@ static void free_unmap_vmap_area_addr(unsigned long addr)
 
 #define VMAP_BLOCK_SIZE		(VMAP_BBMAP_BITS * PAGE_SIZE)
 
-static bool vmap_initialized __read_mostly = false;
-
 struct vmap_block_queue {
 	spinlock_t lock;
 	struct list_head free;
@@ -1157,6 +1342,16 @@ void __init vmalloc_init(void)
 		INIT_LIST_HEAD(&vbq->free);
 	}
 
+	for_each_possible_cpu(i) {
+		struct vmap_area_cache *cache;
+		int j;
+
+		cache = &per_cpu(vmap_area_cache, i);
+		spin_lock_init(&cache->lock);
+		for (j = 0; j < VMAP_CACHE_MAX_PAGES; j++)
+			INIT_LIST_HEAD(&cache->free[j]);
+	}
+
 	/* Import existing vmlist entries. */
 	for (tmp = vmlist; tmp; tmp = tmp->next) {
 		va = kzalloc(sizeof(struct vmap_area), GFP_NOWAIT);
@@ -55,6 +55,7 @@
 #include <linux/cache.h>
 #include <linux/rtnetlink.h>
 #include <linux/init.h>
+#include <linux/cpu.h>
 #include <linux/scatterlist.h>
 #include <linux/errqueue.h>
 #include <linux/prefetch.h>
@@ -74,6 +75,57 @@
 static struct kmem_cache *skbuff_head_cache __read_mostly;
 static struct kmem_cache *skbuff_fclone_cache __read_mostly;
 
+/*
+ * Most skb heads of a busy box are allocated and freed from softirq
+ * context, on the RX and TX completion paths. Keep a small per cpu
+ * stack of them there, refilled and drained in batches with the slab
+ * bulk interface, so the slab pages are touched once per batch instead
+ * of once per packet.
+ */
+#define SKB_HEAD_CACHE_SIZE	64
+#define SKB_HEAD_CACHE_BULK	16
+
+struct skb_head_cache {
+	unsigned int count;
+	void *heads[SKB_HEAD_CACHE_SIZE];
+};
+static DEFINE_PER_CPU(struct skb_head_cache, skb_head_cache);
+
+/*
+ * The cache is only used with bottom halves disabled and outside of
+ * hard interrupts, which serializes all users on a cpu. The slab bulk
+ * interface must not be called with interrupts disabled.
+ */
+static inline bool skb_head_cache_usable(void)
+{
+	return in_softirq() && !in_irq() && !irqs_disabled();
+}
+
+static struct sk_buff *skb_head_cache_get(gfp_t gfp_mask)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(!hc->count)) {
+		if (!kmem_cache_alloc_bulk(skbuff_head_cache, gfp_mask,
+					   SKB_HEAD_CACHE_BULK, hc->heads))
+			return NULL;
+		hc->count = SKB_HEAD_CACHE_BULK;
+	}
+	return hc->heads[--hc->count];
+}
+
+static void skb_head_cache_put(struct sk_buff *skb)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(hc->count == SKB_HEAD_CACHE_SIZE)) {
+		hc->count -= SKB_HEAD_CACHE_SIZE / 2;
+		kmem_cache_free_bulk(skbuff_head_cache, SKB_HEAD_CACHE_SIZE / 2,
+				     hc->heads + hc->count);
+	}
+	hc->heads[hc->count++] = skb;
+}
+
 static void sock_pipe_buf_release(struct pipe_inode_info *pipe,
 				  struct pipe_buffer *buf)
 {
@@ -179,7 +231,10 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	cache = fclone ? skbuff_fclone_cache : skbuff_head_cache;
 
 	/* Get the HEAD */
-	skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
+	if (!fclone && node == NUMA_NO_NODE && skb_head_cache_usable())
+		skb = skb_head_cache_get(gfp_mask & ~__GFP_DMA);
+	else
+		skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
 	if (!skb)
 		goto out;
 	prefetchw(skb);
@@ -369,7 +424,12 @@ static void kfree_skbmem(struct sk_buff *skb)
 
 	switch (skb->fclone) {
 	case SKB_FCLONE_UNAVAILABLE:
-		kmem_cache_free(skbuff_head_cache, skb);
+		/* Heads from other nodes go back to their own slabs */
+		if (skb_head_cache_usable() &&
+		    page_to_nid(virt_to_page(skb)) == numa_mem_id())
+			skb_head_cache_put(skb);
+		else
+			kmem_cache_free(skbuff_head_cache, skb);
 		break;
 
 	case SKB_FCLONE_ORIG:
@@ -2897,6 +2957,19 @@ done:
 }
 EXPORT_SYMBOL_GPL(skb_gro_receive);
 
+static int skb_head_cache_cpu_callback(struct notifier_block *nfb,
+				      unsigned long action, void *hcpu)
+{
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN) {
+		struct skb_head_cache *hc;
+
+		hc = &per_cpu(skb_head_cache, (unsigned long)hcpu);
+		kmem_cache_free_bulk(skbuff_head_cache, hc->count, hc->heads);
+		hc->count = 0;
+	}
+	return NOTIFY_OK;
+}
+
 void __init skb_init(void)
 {
 	skbuff_head_cache = kmem_cache_create("skbuff_head_cache",
@@ -2910,6 +2983,7 @@ void __init skb_init(void)
 						0,
 						SLAB_HWCACHE_ALIGN|SLAB_PANIC,
 						NULL);
+	hotcpu_notifier(skb_head_cache_cpu_callback, 0);
 }
 
 /**
@@ -0,0 +1,189 @@
+/*
+ * epoll-ctl.c
+ *
+ * ctl: Throughput of epoll_ctl() over many fds and threads
+ *
+ * Every thread owns a set of eventfds, and keeps adding, modifying and
+ * removing them on a single epoll instance, or on one instance per
+ * thread with --multiq. Reports the number of epoll_ctl() calls done
+ * per second.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "start.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+
+static int		nr_threads	= 4;
+static int		nr_fds		= 64;
+static int		runtime		= 5;
+static bool		multiq;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads"),
+	OPT_INTEGER('f', "nfds", &nr_fds,
+		    "Specify number of fds per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_BOOLEAN('m', "multiq", &multiq,
+		    "Use an epoll instance per thread instead of a shared one"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ctl_usage[] = {
+	"perf bench epoll ctl <options>",
+	NULL
+};
+
+struct epoll_worker {
+	pthread_t	thread;
+	int		epfd;
+	int		*fds;
+	unsigned long	ops;
+};
+
+static struct bench_start start_barrier = BENCH_START_INIT;
+static volatile bool done;
+
+static void *ctl_thread(void *arg)
+{
+	struct epoll_worker *w = arg;
+	struct epoll_event ev;
+	unsigned long ops = 0;
+	int i;
+
+	bench_start_wait(&start_barrier);
+
+	while (!done) {
+		for (i = 0; i < nr_fds; i++) {
+			ev.events = EPOLLIN;
+			ev.data.fd = w->fds[i];
+			BUG_ON(epoll_ctl(w->epfd, EPOLL_CTL_ADD,
+					 w->fds[i], &ev));
+		}
+		for (i = 0; i < nr_fds; i++) {
+			ev.events = EPOLLIN | EPOLLOUT;
+			ev.data.fd = w->fds[i];
+			BUG_ON(epoll_ctl(w->epfd, EPOLL_CTL_MOD,
+					 w->fds[i], &ev));
+		}
+		for (i = 0; i < nr_fds; i++)
+			BUG_ON(epoll_ctl(w->epfd, EPOLL_CTL_DEL,
+					 w->fds[i], &ev));
+		ops += 3 * nr_fds;
+	}
+	w->ops = ops;
+	return NULL;
+}
+
+int bench_epoll_ctl(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	struct epoll_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long total = 0;
+	int i, j, epfd = -1;
+	double secs;
+
+	argc = parse_options(argc, argv, options,
+			     bench_epoll_ctl_usage, 0);
+
+	if (nr_threads <= 0)
+		nr_threads = 1;
+	if (nr_fds <= 0)
+		nr_fds = 1;
+	if (runtime <= 0)
+		runtime = 1;
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	BUG_ON(!workers);
+
+	for (i = 0; i < nr_threads; i++) {
+		struct epoll_worker *w = &workers[i];
+
+		if (multiq || epfd < 0) {
+			epfd = epoll_create(nr_fds);
+			if (epfd < 0) {
+				fprintf(stderr, "epoll_create: %s\n",
+					strerror(errno));
+				return 1;
+			}
+		}
+		w->epfd = epfd;
+
+		w->fds = zalloc(nr_fds * sizeof(int));
+		BUG_ON(!w->fds);
+		for (j = 0; j < nr_fds; j++) {
+			w->fds[j] = eventfd(0, EFD_NONBLOCK);
+			if (w->fds[j] < 0) {
+				fprintf(stderr, "eventfd: %s "
+					"(too many fds? check ulimit -n)\n",
+					strerror(errno));
+				return 1;
+			}
+		}
+	}
+
+	bench_start_reset(&start_barrier);
+	done = false;
+
+	for (i = 0; i < nr_threads; i++)
+		BUG_ON(pthread_create(&workers[i].thread, NULL,
+				      ctl_thread, &workers[i]));
+
+	bench_start_go(&start_barrier, nr_threads, &start);
+
+	sleep(runtime);
+	done = true;
+
+	for (i = 0; i < nr_threads; i++) {
+		BUG_ON(pthread_join(workers[i].thread, NULL));
+		total += workers[i].ops;
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d thread(s) with %d fds each, %s\n\n",
+		       nr_threads, nr_fds,
+		       multiq ? "one epoll instance per thread" :
+				"one shared epoll instance");
+		printf(" %14lf ops/sec\n", total / secs);
+		printf(" %14lf ops/sec per thread\n",
+		       total / secs / nr_threads);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", total / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		for (j = 0; j < nr_fds; j++)
+			close(workers[i].fds[j]);
+		free(workers[i].fds);
+		if (multiq || !i)
+			close(workers[i].epfd);
+	}
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * futex-hash.c
+ *
+ * hash: Throughput of the futex hash table
+ *
+ * Every thread owns a set of futexes and keeps calling FUTEX_WAIT on
+ * them with a value that does not match, so that each call hashes the
+ * key, takes the bucket lock and returns right away. With many threads
+ * the unrelated futexes collide in the hash, and the throughput shows
+ * how much they get in each other's way.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "start.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int		nr_threads	= 4;
+static int		nr_futexes	= 1024;
+static int		runtime		= 5;
+static int		buckets;
+static bool		fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads"),
+	OPT_INTEGER('f', "futexes", &nr_futexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_BOOLEAN('S', "shared", &fshared,
+		    "Use shared futexes instead of private ones"),
+	OPT_INTEGER('b', "buckets", &buckets,
+		    "Use a private futex hash of this many buckets"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+struct futex_worker {
+	pthread_t	thread;
+	u_int32_t	*futex;
+	unsigned long	ops;
+};
+
+static int futex_flag;
+static struct bench_start start_barrier = BENCH_START_INIT;
+static volatile bool done;
+
+static void *hash_thread(void *arg)
+{
+	struct futex_worker *w = arg;
+	unsigned long ops = 0;
+	int i, ret;
+
+	bench_start_wait(&start_barrier);
+
+	while (!done) {
+		for (i = 0; i < nr_futexes; i++) {
+			/* The futex is 0, so this fails with EAGAIN */
+			ret = futex_wait(&w->futex[i], 1234, NULL, futex_flag);
+			BUG_ON(!ret || errno != EAGAIN);
+			ops++;
+		}
+	}
+	w->ops = ops;
+	return NULL;
+}
+
+int bench_futex_hash(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct futex_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long total = 0, lo = ~0UL, hi = 0;
+	double secs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_hash_usage, 0);
+
+	if (nr_threads <= 0)
+		nr_threads = 1;
+	if (nr_futexes <= 0)
+		nr_futexes = 1;
+	if (runtime <= 0)
+		runtime = 1;
+	futex_flag = fshared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	/* Must be done before there is any other thread */
+	if (buckets > 0 && futex_hash_size(buckets)) {
+		fprintf(stderr, "Failed to set up a private futex hash: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	BUG_ON(!workers);
+
+	bench_start_reset(&start_barrier);
+	done = false;
+
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].futex = zalloc(nr_futexes * sizeof(u_int32_t));
+		BUG_ON(!workers[i].futex);
+		BUG_ON(pthread_create(&workers[i].thread, NULL,
+				      hash_thread, &workers[i]));
+	}
+
+	bench_start_go(&start_barrier, nr_threads, &start);
+
+	sleep(runtime);
+	done = true;
+
+	for (i = 0; i < nr_threads; i++) {
+		BUG_ON(pthread_join(workers[i].thread, NULL));
+		total += workers[i].ops;
+		lo = min(lo, workers[i].ops);
+		hi = max(hi, workers[i].ops);
+		free(workers[i].futex);
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d thread(s) on %d %s futexes each",
+		       nr_threads, nr_futexes, fshared ? "shared" : "private");
+		if (buckets > 0)
+			printf(", private hash of %d buckets", buckets);
+		printf("\n\n");
+		printf(" %14lf ops/sec\n", total / secs);
+		printf(" %14lf ops/sec per thread (min %lf, max %lf)\n",
+		       total / secs / nr_threads, lo / secs, hi / secs);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", total / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * futex-lock-pi.c
+ *
+ * lock-pi: Throughput of a contended PI futex
+ *
+ * Threads take and release a single priority inheritance futex, the way
+ * a PTHREAD_PRIO_INHERIT mutex does: the uncontended cases are handled
+ * with cmpxchg in userspace, and FUTEX_LOCK_PI / FUTEX_UNLOCK_PI are
+ * only called when the lock is contended. Reports the number of lock
+ * acquisitions per second, and how many of them went to the kernel.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "start.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int		nr_threads	= 4;
+static int		runtime		= 5;
+static int		cs_loops	= 100;
+static bool		fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_INTEGER('l', "loops", &cs_loops,
+		    "Specify number of loops inside the critical section"),
+	OPT_BOOLEAN('S', "shared", &fshared,
+		    "Use a shared futex instead of a private one"),
+	OPT_END()
+};
+
+static const char * const bench_futex_lock_pi_usage[] = {
+	"perf bench futex lock-pi <options>",
+	NULL
+};
+
+struct pi_worker {
+	pthread_t	thread;
+	unsigned long	ops;
+	unsigned long	locks;		/* FUTEX_LOCK_PI calls */
+};
+
+static u_int32_t global_futex;
+static int futex_flag;
+static struct bench_start start_barrier = BENCH_START_INIT;
+static volatile bool done;
+
+static void *lock_thread(void *arg)
+{
+	struct pi_worker *w = arg;
+	u_int32_t tid = syscall(SYS_gettid);
+	volatile int spin;
+	int i, ret;
+
+	bench_start_wait(&start_barrier);
+
+	while (!done) {
+		if (!__sync_bool_compare_and_swap(&global_futex, 0, tid)) {
+			ret = futex_lock_pi(&global_futex, NULL, 0, futex_flag);
+			BUG_ON(ret && errno != EINTR);
+			w->locks++;
+			if (ret)
+				continue;
+		}
+
+		for (i = 0, spin = 0; i < cs_loops; i++)
+			spin++;
+		w->ops++;
+
+		if (!__sync_bool_compare_and_swap(&global_futex, tid, 0))
+			BUG_ON(futex_unlock_pi(&global_futex, futex_flag));
+	}
+	return NULL;
+}
+
+int bench_futex_lock_pi(int argc, const char **argv,
+			const char *prefix __used)
+{
+	struct pi_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long total = 0, locks = 0;
+	double secs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_lock_pi_usage, 0);
+
+	if (nr_threads <= 0)
+		nr_threads = 1;
+	if (runtime <= 0)
+		runtime = 1;
+	if (cs_loops < 0)
+		cs_loops = 0;
+	futex_flag = fshared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	BUG_ON(!workers);
+
+	bench_start_reset(&start_barrier);
+	done = false;
+
+	for (i = 0; i < nr_threads; i++)
+		BUG_ON(pthread_create(&workers[i].thread, NULL,
+				      lock_thread, &workers[i]));
+
+	bench_start_go(&start_barrier, nr_threads, &start);
+
+	sleep(runtime);
+	done = true;
+
+	for (i = 0; i < nr_threads; i++) {
+		BUG_ON(pthread_join(workers[i].thread, NULL));
+		total += workers[i].ops;
+		locks += workers[i].locks;
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d thread(s) on a %s PI futex\n\n",
+		       nr_threads, fshared ? "shared" : "private");
+		printf(" %14lf locks/sec\n", total / secs);
+		printf(" %14lf FUTEX_LOCK_PI/sec\n", locks / secs);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf\n", total / secs, locks / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * futex-requeue.c
+ *
+ * requeue: Cost of FUTEX_CMP_REQUEUE on a futex with many waiters
+ *
+ * Threads block on a first futex, then the main thread moves them all
+ * to a second one, a few at a time, the way a condition variable
+ * broadcast hands its waiters over to the mutex, and measures how long
+ * it takes. The threads are then woken from the second futex. This is
+ * repeated a number of times and the average is reported.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int		nr_threads	= 16;
+static int		nr_requeue	= 1;
+static int		repeat		= 10;
+static bool		fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of waiting threads"),
+	OPT_INTEGER('q', "nrequeue", &nr_requeue,
+		    "Specify number of threads requeued by each call"),
+	OPT_INTEGER('r', "repeat", &repeat,
+		    "Specify number of rounds"),
+	OPT_BOOLEAN('S', "shared", &fshared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_requeue_usage[] = {
+	"perf bench futex requeue <options>",
+	NULL
+};
+
+static u_int32_t futex1, futex2;
+static int futex_flag;
+
+static void *wait_thread(void *arg __used)
+{
+	while (futex_wait(&futex1, 0, NULL, futex_flag) && errno == EINTR)
+		;
+	return NULL;
+}
+
+int bench_futex_requeue(int argc, const char **argv,
+			const char *prefix __used)
+{
+	pthread_t *threads;
+	struct timeval start, stop, diff;
+	unsigned long long usecs, total_usecs = 0;
+	int i, r, requeued, woken;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_requeue_usage, 0);
+
+	if (nr_threads <= 0)
+		nr_threads = 1;
+	if (nr_requeue <= 0)
+		nr_requeue = 1;
+	if (repeat <= 0)
+		repeat = 1;
+	futex_flag = fshared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	threads = zalloc(nr_threads * sizeof(*threads));
+	BUG_ON(!threads);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d thread(s) waiting on a %s futex, "
+		       "requeued %d at a time\n\n",
+		       nr_threads, fshared ? "shared" : "private", nr_requeue);
+
+	for (r = 0; r < repeat; r++) {
+		for (i = 0; i < nr_threads; i++)
+			BUG_ON(pthread_create(&threads[i], NULL,
+					      wait_thread, NULL));
+
+		/* Give the threads time to block */
+		usleep(100000);
+
+		/*
+		 * Wake nobody, only requeue. The return value counts both the
+		 * woken and the requeued tasks.
+		 */
+		requeued = 0;
+		BUG_ON(gettimeofday(&start, NULL));
+		while (requeued < nr_threads) {
+			int ret = futex_cmp_requeue(&futex1, 0, &futex2, 0,
+						    nr_requeue, futex_flag);
+
+			BUG_ON(ret < 0);
+			requeued += ret;
+		}
+		BUG_ON(gettimeofday(&stop, NULL));
+		timersub(&stop, &start, &diff);
+
+		woken = 0;
+		while (woken < nr_threads)
+			woken += futex_wake(&futex2, nr_threads, futex_flag);
+
+		for (i = 0; i < nr_threads; i++)
+			BUG_ON(pthread_join(threads[i], NULL));
+
+		usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+		total_usecs += usecs;
+
+		if (bench_format == BENCH_FORMAT_DEFAULT)
+			printf(" round %2d: requeued %d threads in %llu usecs\n",
+			       r, requeued, usecs);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("\n %14lf usecs average to requeue all threads\n",
+		       (double)total_usecs / repeat);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)total_usecs / repeat);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(threads);
+	return 0;
+}
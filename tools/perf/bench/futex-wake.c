@@ -0,0 +1,128 @@
+/*
+ * futex-wake.c
+ *
+ * wake: Cost of FUTEX_WAKE on a futex with many waiters
+ *
+ * Threads block on a single futex, then the main thread wakes them all,
+ * a few at a time, and measures how long it takes. This is repeated a
+ * number of times and the average is reported.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int		nr_threads	= 16;
+static int		nr_wake		= 1;
+static int		repeat		= 10;
+static bool		fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of waiting threads"),
+	OPT_INTEGER('w', "nwakes", &nr_wake,
+		    "Specify number of threads woken by each FUTEX_WAKE"),
+	OPT_INTEGER('r', "repeat", &repeat,
+		    "Specify number of rounds"),
+	OPT_BOOLEAN('S', "shared", &fshared,
+		    "Use a shared futex instead of a private one"),
+	OPT_END()
+};
+
+static const char * const bench_futex_wake_usage[] = {
+	"perf bench futex wake <options>",
+	NULL
+};
+
+static u_int32_t futex1;
+static int futex_flag;
+
+static void *wait_thread(void *arg __used)
+{
+	/* A spurious wakeup is counted by nobody, so just wait again */
+	while (futex_wait(&futex1, 0, NULL, futex_flag) && errno == EINTR)
+		;
+	return NULL;
+}
+
+int bench_futex_wake(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	pthread_t *threads;
+	struct timeval start, stop, diff;
+	unsigned long long usecs, total_usecs = 0;
+	int i, r, woken;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_wake_usage, 0);
+
+	if (nr_threads <= 0)
+		nr_threads = 1;
+	if (nr_wake <= 0)
+		nr_wake = 1;
+	if (repeat <= 0)
+		repeat = 1;
+	futex_flag = fshared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	threads = zalloc(nr_threads * sizeof(*threads));
+	BUG_ON(!threads);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d thread(s) waiting on a %s futex, "
+		       "woken %d at a time\n\n",
+		       nr_threads, fshared ? "shared" : "private", nr_wake);
+
+	for (r = 0; r < repeat; r++) {
+		for (i = 0; i < nr_threads; i++)
+			BUG_ON(pthread_create(&threads[i], NULL,
+					      wait_thread, NULL));
+
+		/* Give the threads time to block */
+		usleep(100000);
+
+		woken = 0;
+		BUG_ON(gettimeofday(&start, NULL));
+		while (woken < nr_threads)
+			woken += futex_wake(&futex1, nr_wake, futex_flag);
+		BUG_ON(gettimeofday(&stop, NULL));
+		timersub(&stop, &start, &diff);
+
+		for (i = 0; i < nr_threads; i++)
+			BUG_ON(pthread_join(threads[i], NULL));
+
+		usecs = diff.tv_sec * 1000000ULL + diff.tv_usec;
+		total_usecs += usecs;
+
+		if (bench_format == BENCH_FORMAT_DEFAULT)
+			printf(" round %2d: woke %d threads in %llu usecs\n",
+			       r, woken, usecs);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("\n %14lf usecs average to wake all threads\n",
+		       (double)total_usecs / repeat);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)total_usecs / repeat);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(threads);
+	return 0;
+}
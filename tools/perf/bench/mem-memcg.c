@@ -0,0 +1,238 @@
+/*
+ * mem-memcg.c
+ *
+ * memcg: Anonymous page fault cost against memory cgroup hierarchy depth
+ *
+ * The benchmark builds a chain of nested memory cgroups below the given
+ * memcg mount point, with use_hierarchy set, and moves itself into the
+ * deepest one. Every charge has to be accounted in all the ancestors,
+ * so the cost of a page fault shows how charging scales with depth.
+ * Several threads can fault at the same time to add contention on the
+ * shared counters.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "start.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define K 1024
+
+static const char	*root_str	= "/sys/fs/cgroup/memory";
+static const char	*size_str	= "64MB";
+static int		max_depth	= 5;
+static int		nr_threads	= 1;
+
+static const struct option options[] = {
+	OPT_STRING('c', "cgroup", &root_str, "/sys/fs/cgroup/memory",
+		    "Specify mount point of the memory cgroup hierarchy"),
+	OPT_INTEGER('d', "depth", &max_depth,
+		    "Specify maximum depth of the cgroup hierarchy"),
+	OPT_STRING('s', "size", &size_str, "64MB",
+		    "Specify size of memory faulted in by each thread. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads faulting concurrently"),
+	OPT_END()
+};
+
+static const char * const bench_mem_memcg_usage[] = {
+	"perf bench mem memcg <options>",
+	NULL
+};
+
+struct fault_worker {
+	pthread_t	thread;
+	struct timeval	runtime;
+};
+
+static size_t region_size;
+static struct bench_start start_barrier = BENCH_START_INIT;
+
+static void *fault_thread(void *arg)
+{
+	struct fault_worker *w = arg;
+	struct timeval start, stop;
+	long page_size = sysconf(_SC_PAGESIZE);
+	char *region;
+	size_t off;
+
+	region = mmap(NULL, region_size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	BUG_ON(region == MAP_FAILED);
+
+	bench_start_wait(&start_barrier);
+
+	BUG_ON(gettimeofday(&start, NULL));
+	for (off = 0; off < region_size; off += page_size)
+		region[off] = 1;
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &w->runtime);
+
+	munmap(region, region_size);
+	return NULL;
+}
+
+static int write_file(const char *dir, const char *file, const char *val)
+{
+	char path[PATH_MAX];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, file);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	ret = write(fd, val, strlen(val));
+	close(fd);
+	return ret < 0 ? -1 : 0;
+}
+
+static int enter_cgroup(const char *dir)
+{
+	char pid[32];
+
+	snprintf(pid, sizeof(pid), "%d\n", getpid());
+	return write_file(dir, "tasks", pid);
+}
+
+/* Build the path of the cgroup at @depth, 0 being the mount point */
+static void cgroup_path(char *path, size_t len, int depth)
+{
+	int i, n;
+
+	n = snprintf(path, len, "%s", root_str);
+	if (depth)
+		n += snprintf(path + n, len - n, "/perf-bench-memcg.%d",
+			      getpid());
+	for (i = 1; i < depth; i++)
+		n += snprintf(path + n, len - n, "/%d", i);
+}
+
+static void remove_cgroups(int depth)
+{
+	char path[PATH_MAX];
+
+	cgroup_path(path, sizeof(path), 0);
+	enter_cgroup(path);
+
+	for (; depth > 0; depth--) {
+		cgroup_path(path, sizeof(path), depth);
+		rmdir(path);
+	}
+}
+
+static double run_depth(struct fault_worker *workers)
+{
+	struct timeval start, stop, diff;
+	double thread_secs = 0.0;
+	int i;
+
+	bench_start_reset(&start_barrier);
+
+	for (i = 0; i < nr_threads; i++)
+		BUG_ON(pthread_create(&workers[i].thread, NULL,
+				      fault_thread, &workers[i]));
+
+	bench_start_go(&start_barrier, nr_threads, &start);
+
+	for (i = 0; i < nr_threads; i++) {
+		BUG_ON(pthread_join(workers[i].thread, NULL));
+		thread_secs += (double)workers[i].runtime.tv_sec +
+			(double)workers[i].runtime.tv_usec / 1000000;
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &diff);
+
+	/* Average cost of one fault as seen by a faulting thread */
+	return thread_secs * 1000000000 /
+		((double)region_size / sysconf(_SC_PAGESIZE) * nr_threads);
+}
+
+int bench_mem_memcg(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	struct fault_worker *workers;
+	char path[PATH_MAX];
+	int depth, ret = 0;
+	double nsecs;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_memcg_usage, 0);
+
+	if (max_depth < 0)
+		max_depth = 0;
+	if (nr_threads <= 0)
+		nr_threads = 1;
+
+	region_size = (size_t)perf_atoll((char *)size_str);
+	if ((s64)region_size <= 0) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	BUG_ON(!workers);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d thread(s) faulting %lu MB each\n\n",
+		       nr_threads, (unsigned long)(region_size / K / K));
+
+	for (depth = 0; depth <= max_depth; depth++) {
+		cgroup_path(path, sizeof(path), depth);
+		if (depth && mkdir(path, 0755) < 0) {
+			fprintf(stderr, "Failed to create %s: %s\n",
+				path, strerror(errno));
+			ret = 1;
+			break;
+		}
+		/* Charges must propagate to all the ancestors */
+		if (depth == 1 && write_file(path, "memory.use_hierarchy", "1")) {
+			fprintf(stderr, "Failed to enable use_hierarchy: %s\n",
+				strerror(errno));
+			ret = 1;
+			depth++;
+			break;
+		}
+		if (enter_cgroup(path)) {
+			fprintf(stderr, "Failed to enter %s: %s\n",
+				path, strerror(errno));
+			ret = 1;
+			depth++;
+			break;
+		}
+
+		nsecs = run_depth(workers);
+
+		switch (bench_format) {
+		case BENCH_FORMAT_DEFAULT:
+			printf(" depth %2d: %14lf nsecs/fault\n", depth, nsecs);
+			break;
+
+		case BENCH_FORMAT_SIMPLE:
+			printf("%d %lf\n", depth, nsecs);
+			break;
+
+		default:
+			/* reaching here is something disaster */
+			fprintf(stderr, "Unknown format:%d\n", bench_format);
+			exit(1);
+			break;
+		}
+	}
+
+	remove_cgroups(depth - 1);
+	free(workers);
+	return ret;
+}
@@ -0,0 +1,206 @@
+/*
+ * mem-mmap.c
+ *
+ * mmap: Page faults mixed with mmap()/munmap() in one address space
+ *
+ * Fault threads keep faulting in their own slice of a shared anonymous
+ * region, dropping it with MADV_DONTNEED after every pass, which takes
+ * mmap_sem for reading. Map threads keep mapping, touching and unmapping
+ * a small region, which takes it for writing. The throughput of both
+ * sides shows how mmap_sem behaves with readers and writers mixed.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "start.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#define K 1024
+
+static const char	*size_str	= "16MB";
+static int		nr_fault_threads = 4;
+static int		nr_map_threads	= 1;
+static int		map_pages	= 4;
+static int		runtime		= 5;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "16MB",
+		    "Specify size of memory faulted in by each fault thread. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_fault_threads,
+		    "Specify number of threads faulting"),
+	OPT_INTEGER('m', "mappers", &nr_map_threads,
+		    "Specify number of threads doing mmap()/munmap()"),
+	OPT_INTEGER('p', "pages", &map_pages,
+		    "Specify number of pages mapped at a time by map threads"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_mem_mmap_usage[] = {
+	"perf bench mem mmap <options>",
+	NULL
+};
+
+struct mmap_worker {
+	pthread_t	thread;
+	char		*slice;
+	unsigned long	ops;
+};
+
+static size_t slice_size;
+static long page_size;
+static struct bench_start start_barrier = BENCH_START_INIT;
+static volatile bool done;
+
+static void *fault_thread(void *arg)
+{
+	struct mmap_worker *w = arg;
+	unsigned long faults = 0;
+	size_t off;
+
+	bench_start_wait(&start_barrier);
+
+	while (!done) {
+		for (off = 0; off < slice_size && !done; off += page_size) {
+			w->slice[off] = 1;
+			faults++;
+		}
+		BUG_ON(madvise(w->slice, slice_size, MADV_DONTNEED));
+	}
+	w->ops = faults;
+	return NULL;
+}
+
+static void *map_thread(void *arg)
+{
+	struct mmap_worker *w = arg;
+	size_t len = map_pages * page_size;
+	unsigned long maps = 0;
+	size_t off;
+	char *p;
+
+	bench_start_wait(&start_barrier);
+
+	while (!done) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		BUG_ON(p == MAP_FAILED);
+		for (off = 0; off < len; off += page_size)
+			p[off] = 1;
+		BUG_ON(munmap(p, len));
+		maps++;
+	}
+	w->ops = maps;
+	return NULL;
+}
+
+int bench_mem_mmap(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	struct mmap_worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long faults = 0, maps = 0;
+	int i, nr_workers;
+	double secs;
+	char *region;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_mmap_usage, 0);
+
+	if (nr_fault_threads < 0)
+		nr_fault_threads = 0;
+	if (nr_map_threads < 0)
+		nr_map_threads = 0;
+	if (map_pages <= 0)
+		map_pages = 1;
+	if (runtime <= 0)
+		runtime = 1;
+	nr_workers = nr_fault_threads + nr_map_threads;
+	if (!nr_workers) {
+		fprintf(stderr, "Nothing to do\n");
+		return 1;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	slice_size = (size_t)perf_atoll((char *)size_str);
+	if ((s64)slice_size <= 0) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+
+	region = NULL;
+	if (nr_fault_threads) {
+		region = mmap(NULL, slice_size * nr_fault_threads,
+			      PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		BUG_ON(region == MAP_FAILED);
+	}
+
+	workers = zalloc(nr_workers * sizeof(*workers));
+	BUG_ON(!workers);
+
+	bench_start_reset(&start_barrier);
+	done = false;
+
+	for (i = 0; i < nr_workers; i++) {
+		if (i < nr_fault_threads) {
+			workers[i].slice = region + i * slice_size;
+			BUG_ON(pthread_create(&workers[i].thread, NULL,
+					      fault_thread, &workers[i]));
+		} else
+			BUG_ON(pthread_create(&workers[i].thread, NULL,
+					      map_thread, &workers[i]));
+	}
+
+	bench_start_go(&start_barrier, nr_workers, &start);
+
+	sleep(runtime);
+	done = true;
+
+	for (i = 0; i < nr_workers; i++) {
+		BUG_ON(pthread_join(workers[i].thread, NULL));
+		if (i < nr_fault_threads)
+			faults += workers[i].ops;
+		else
+			maps += workers[i].ops;
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d fault thread(s) over %lu KB each, "
+		       "%d mmap thread(s) of %d page(s)\n\n",
+		       nr_fault_threads, (unsigned long)(slice_size / K),
+		       nr_map_threads, map_pages);
+		printf(" %14lf faults/sec\n", faults / secs);
+		printf(" %14lf mmap+munmap/sec\n", maps / secs);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf\n", faults / secs, maps / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	if (region)
+		munmap(region, slice_size * nr_fault_threads);
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * mem-reclaim.c
+ *
+ * reclaim: Page cache churn from many threads to stress LRU reclaim
+ *
+ * Every thread streams through its own sparse file with read(). Reading
+ * holes fills the page cache without any disk I/O, so once the files
+ * together exceed memory the run is dominated by page cache insertion,
+ * LRU isolation and reclaim. Run it with an increasing number of threads
+ * to see how reclaim scales with cores.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "start.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define K 1024
+#define READ_CHUNK	(64 * K)
+
+static int		nr_threads;
+static const char	*size_str;
+static const char	*dir_str	= ".";
+static int		loops		= 1;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online CPUs)"),
+	OPT_STRING('s', "size", &size_str, "size",
+		    "Specify size of the file read by each thread (required). "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_STRING('d', "dir", &dir_str, ".",
+		    "Specify directory for the sparse files"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of passes over each file"),
+	OPT_END()
+};
+
+static const char * const bench_mem_reclaim_usage[] = {
+	"perf bench mem reclaim <options>",
+	NULL
+};
+
+struct reclaim_worker {
+	pthread_t	thread;
+	int		fd;
+	u64		bytes;
+	struct timeval	runtime;
+};
+
+static size_t file_size;
+static struct bench_start start_barrier = BENCH_START_INIT;
+
+static void *reclaim_thread(void *arg)
+{
+	struct reclaim_worker *w = arg;
+	struct timeval start, stop;
+	char *buf;
+	int i;
+
+	buf = malloc(READ_CHUNK);
+	BUG_ON(!buf);
+
+	bench_start_wait(&start_barrier);
+
+	BUG_ON(gettimeofday(&start, NULL));
+	for (i = 0; i < loops; i++) {
+		off_t off;
+
+		for (off = 0; off < (off_t)file_size; off += READ_CHUNK) {
+			ssize_t ret = pread(w->fd, buf, READ_CHUNK, off);
+
+			if (ret <= 0)
+				break;
+			w->bytes += ret;
+		}
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &w->runtime);
+
+	free(buf);
+	return NULL;
+}
+
+static int open_sparse_file(int nr)
+{
+	char path[PATH_MAX];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/perf-bench-reclaim.%d.%d",
+		 dir_str, getpid(), nr);
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		return -1;
+	unlink(path);
+
+	if (ftruncate(fd, file_size) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static double timeval2double(struct timeval *ts)
+{
+	return (double)ts->tv_sec +
+		(double)ts->tv_usec / (double)1000000;
+}
+
+int bench_mem_reclaim(int argc, const char **argv,
+		      const char *prefix __used)
+{
+	struct reclaim_worker *workers;
+	struct timeval start, stop, diff;
+	u64 total_bytes = 0;
+	double secs, thread_secs = 0.0;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_reclaim_usage, 0);
+
+	if (nr_threads <= 0)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (loops <= 0)
+		loops = 1;
+
+	/*
+	 * No default: one that does not exceed memory measures page cache
+	 * fill rather than reclaim, and one that does would evict all of
+	 * the page cache on every 'perf bench all'.
+	 */
+	if (!size_str) {
+		fprintf(stderr, "--size is required; reclaim runs all along "
+			"once the files of all threads exceed memory (%llu MB)\n",
+			(unsigned long long)sysconf(_SC_PHYS_PAGES) *
+			sysconf(_SC_PAGESIZE) >> 20);
+		return 1;
+	}
+	file_size = (size_t)perf_atoll((char *)size_str);
+	if ((s64)file_size <= 0) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	BUG_ON(!workers);
+
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].fd = open_sparse_file(i);
+		if (workers[i].fd < 0) {
+			fprintf(stderr, "Failed to create file in %s: %s\n",
+				dir_str, strerror(errno));
+			return 1;
+		}
+		BUG_ON(pthread_create(&workers[i].thread, NULL,
+				      reclaim_thread, &workers[i]));
+	}
+
+	bench_start_go(&start_barrier, nr_threads, &start);
+
+	for (i = 0; i < nr_threads; i++) {
+		BUG_ON(pthread_join(workers[i].thread, NULL));
+		total_bytes += workers[i].bytes;
+		thread_secs += timeval2double(&workers[i].runtime);
+		close(workers[i].fd);
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &diff);
+	secs = timeval2double(&diff);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads reading %lu MB each, %d pass(es)\n\n",
+		       nr_threads, (unsigned long)(file_size / K / K), loops);
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+		printf(" %14lf MB/Sec total\n",
+		       (double)total_bytes / K / K / secs);
+		printf(" %14lf MB/Sec per thread\n",
+		       (double)total_bytes / K / K / thread_secs);
+		printf(" %14lf usecs/page\n",
+		       secs * 1000000 * nr_threads /
+		       ((double)total_bytes / sysconf(_SC_PAGESIZE)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec, (unsigned long)(diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	free(workers);
+	return 0;
+}
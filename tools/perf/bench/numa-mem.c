@@ -0,0 +1,283 @@
+/*
+ * numa-mem.c
+ *
+ * mem: Memory bandwidth of threads against local and remote nodes
+ *
+ * Threads bound to the cpus of one node read through buffers of their
+ * own, bound to each memory node in turn, so that local and remote
+ * bandwidth can be compared, along with the node distance reported by
+ * the firmware. Memory placement is done with mbind() directly, so that
+ * there is no dependency on libnuma.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "start.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+
+#define K 1024
+
+/* From linux/mempolicy.h */
+#define MPOL_BIND		2
+#define MPOL_MF_STRICT		(1 << 0)
+
+#define MAX_NODES		(sizeof(unsigned long) * 8)
+
+static const char	*size_str	= "64MB";
+static int		nr_threads;
+static int		loops		= 5;
+static int		cpu_node;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "64MB",
+		    "Specify size of the buffer of each thread. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: cpus of the node)"),
+	OPT_INTEGER('l', "loops", &loops,
+		    "Specify number of passes over each buffer"),
+	OPT_INTEGER('c', "cpu-node", &cpu_node,
+		    "Specify node whose cpus the threads run on"),
+	OPT_END()
+};
+
+static const char * const bench_numa_mem_usage[] = {
+	"perf bench numa mem <options>",
+	NULL
+};
+
+struct numa_worker {
+	pthread_t	thread;
+	int		cpu;
+	int		mem_node;
+	struct timeval	runtime;
+	u64		sum;
+};
+
+static size_t buf_size;
+static struct bench_start start_barrier = BENCH_START_INIT;
+
+/* Parse a sysfs cpu or node list, such as "0-3,8-11", into a bitmap */
+static int parse_list(const char *path, unsigned char *map, int max)
+{
+	char buf[4096], *p;
+	FILE *f;
+	int a, b, n = 0;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	p = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (!p)
+		return -1;
+
+	memset(map, 0, max);
+	while (*p && *p != '\n') {
+		a = b = strtol(p, &p, 10);
+		if (*p == '-')
+			b = strtol(p + 1, &p, 10);
+		for (; a <= b && a < max; a++, n++)
+			map[a] = 1;
+		if (*p == ',')
+			p++;
+	}
+	return n;
+}
+
+static int node_distance(int from, int to)
+{
+	char path[PATH_MAX];
+	FILE *f;
+	int i, d = -1;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/node/node%d/distance", from);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	for (i = 0; i <= to; i++)
+		if (fscanf(f, "%d", &d) != 1) {
+			d = -1;
+			break;
+		}
+	fclose(f);
+	return d;
+}
+
+static void *numa_thread(void *arg)
+{
+	struct numa_worker *w = arg;
+	unsigned long nodemask = 1UL << w->mem_node;
+	struct timeval start, stop;
+	cpu_set_t mask;
+	u64 *buf, sum = 0;
+	size_t i, n = buf_size / sizeof(u64);
+	int l;
+
+	CPU_ZERO(&mask);
+	CPU_SET(w->cpu, &mask);
+	BUG_ON(sched_setaffinity(0, sizeof(mask), &mask));
+
+	buf = mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	BUG_ON(buf == MAP_FAILED);
+	/* Place the buffer before it is faulted in */
+	if (syscall(SYS_mbind, buf, buf_size, MPOL_BIND, &nodemask,
+		    MAX_NODES + 1, MPOL_MF_STRICT))
+		die("mbind to node %d failed: %s\n", w->mem_node,
+		    strerror(errno));
+	for (i = 0; i < n; i++)
+		buf[i] = i;
+
+	bench_start_wait(&start_barrier);
+
+	BUG_ON(gettimeofday(&start, NULL));
+	for (l = 0; l < loops; l++)
+		for (i = 0; i < n; i++)
+			sum += buf[i];
+	BUG_ON(gettimeofday(&stop, NULL));
+	timersub(&stop, &start, &w->runtime);
+
+	/* Keep the compiler from dropping the loop */
+	w->sum = sum;
+	munmap(buf, buf_size);
+	return NULL;
+}
+
+/* Returns the bandwidth of all the threads together, in bytes/sec */
+static double run_node(struct numa_worker *workers, int *cpus, int mem_node)
+{
+	double secs = 0.0;
+	int i;
+
+	bench_start_reset(&start_barrier);
+
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].cpu = cpus[i];
+		workers[i].mem_node = mem_node;
+		BUG_ON(pthread_create(&workers[i].thread, NULL,
+				      numa_thread, &workers[i]));
+	}
+
+	bench_start_go(&start_barrier, nr_threads, NULL);
+
+	for (i = 0; i < nr_threads; i++) {
+		BUG_ON(pthread_join(workers[i].thread, NULL));
+		secs += (double)workers[i].runtime.tv_sec +
+			(double)workers[i].runtime.tv_usec / 1000000;
+	}
+
+	/* Average time of a thread, for the bytes read by all of them */
+	secs /= nr_threads;
+	return (double)buf_size * loops * nr_threads / secs;
+}
+
+int bench_numa_mem(int argc, const char **argv,
+		   const char *prefix __used)
+{
+	unsigned char nodes[MAX_NODES], *cpu_map;
+	struct numa_worker *workers;
+	char path[PATH_MAX];
+	int nr_cpus, node_cpus, node, i, n, *cpus;
+	double bps;
+
+	argc = parse_options(argc, argv, options,
+			     bench_numa_mem_usage, 0);
+
+	if (loops <= 0)
+		loops = 1;
+
+	buf_size = (size_t)perf_atoll((char *)size_str);
+	if ((s64)buf_size <= 0) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+
+	if (parse_list("/sys/devices/system/node/online",
+		       nodes, MAX_NODES) <= 0) {
+		fprintf(stderr, "No NUMA node information in sysfs\n");
+		return 1;
+	}
+	if (cpu_node < 0 || cpu_node >= (int)MAX_NODES || !nodes[cpu_node]) {
+		fprintf(stderr, "Invalid cpu node:%d\n", cpu_node);
+		return 1;
+	}
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	cpu_map = zalloc(nr_cpus);
+	cpus = zalloc(nr_cpus * sizeof(int));
+	BUG_ON(!cpu_map || !cpus);
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/node/node%d/cpulist", cpu_node);
+	node_cpus = parse_list(path, cpu_map, nr_cpus);
+	if (node_cpus <= 0) {
+		fprintf(stderr, "No cpus on node %d\n", cpu_node);
+		return 1;
+	}
+	for (i = 0, n = 0; i < nr_cpus; i++)
+		if (cpu_map[i])
+			cpus[n++] = i;
+
+	/* More threads than cpus share the cpus round-robin */
+	if (nr_threads <= 0)
+		nr_threads = node_cpus;
+	if (nr_threads > node_cpus) {
+		cpus = realloc(cpus, nr_threads * sizeof(int));
+		BUG_ON(!cpus);
+		for (i = node_cpus; i < nr_threads; i++)
+			cpus[i] = cpus[i % node_cpus];
+	}
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	BUG_ON(!workers);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d thread(s) on node %d reading %lu MB each, "
+		       "%d time(s)\n\n", nr_threads, cpu_node,
+		       (unsigned long)(buf_size / K / K), loops);
+
+	for (node = 0; node < (int)MAX_NODES; node++) {
+		if (!nodes[node])
+			continue;
+
+		bps = run_node(workers, cpus, node);
+
+		switch (bench_format) {
+		case BENCH_FORMAT_DEFAULT:
+			printf(" memory node %2d (distance %3d): "
+			       "%14lf MB/Sec%s\n", node,
+			       node_distance(cpu_node, node), bps / K / K,
+			       node == cpu_node ? " (local)" : "");
+			break;
+
+		case BENCH_FORMAT_SIMPLE:
+			printf("%d %d %d %lf\n", cpu_node, node,
+			       node_distance(cpu_node, node), bps);
+			break;
+
+		default:
+			/* reaching here is something disaster */
+			fprintf(stderr, "Unknown format:%d\n", bench_format);
+			exit(1);
+			break;
+		}
+	}
+
+	free(workers);
+	free(cpus);
+	free(cpu_map);
+	return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * start.c
+ *
+ * Start barrier shared by the threaded benchmarks, see start.h
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "start.h"
+
+#include <linux/kernel.h>
+
+/* Get ready for a new run, before any worker is created */
+void bench_start_reset(struct bench_start *s)
+{
+	s->nr_ready = 0;
+	s->go = false;
+}
+
+/* Called by each worker once it is set up; returns when the run starts */
+void bench_start_wait(struct bench_start *s)
+{
+	pthread_mutex_lock(&s->lock);
+	s->nr_ready++;
+	pthread_cond_broadcast(&s->cond);
+	while (!s->go)
+		pthread_cond_wait(&s->cond, &s->lock);
+	pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * Called by the main thread: waits for nr_workers workers to be ready,
+ * notes the start time in *start unless it is NULL, and releases them.
+ */
+void bench_start_go(struct bench_start *s, int nr_workers,
+		    struct timeval *start)
+{
+	pthread_mutex_lock(&s->lock);
+	while (s->nr_ready < nr_workers)
+		pthread_cond_wait(&s->cond, &s->lock);
+	if (start)
+		BUG_ON(gettimeofday(start, NULL));
+	s->go = true;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+}
@@ -0,0 +1,29 @@
+#ifndef BENCH_START_H
+#define BENCH_START_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/*
+ * Start barrier for the threaded benchmarks: the workers block in
+ * bench_start_wait() until all of them are set up, and are released
+ * together by bench_start_go(), so that none of them runs its loop
+ * against threads that are still being created.
+ */
+struct bench_start {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	int		nr_ready;
+	bool		go;
+};
+
+#define BENCH_START_INIT						\
+	{ PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, false }
+
+extern void bench_start_reset(struct bench_start *s);
+extern void bench_start_wait(struct bench_start *s);
+extern void bench_start_go(struct bench_start *s, int nr_workers,
+			   struct timeval *start);
+
+#endif /* BENCH_START_H */
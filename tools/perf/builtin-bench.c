@@ -13,6 +13,9 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  futex ... futex hashing and wakeups
+ *  epoll ... epoll scalability
+ *  numa  ... NUMA memory placement
  *
  */
 
@@ -52,6 +55,60 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "memset",
+	  "Simple memory set in various ways",
+	  bench_mem_memset },
+	{ "reclaim",
+	  "Page cache churn from many threads to stress LRU reclaim",
+	  bench_mem_reclaim },
+	{ "memcg",
+	  "Page fault cost against memory cgroup hierarchy depth",
+	  bench_mem_memcg },
+	{ "mmap",
+	  "Page faults mixed with mmap()/munmap() on one mmap_sem",
+	  bench_mem_mmap },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Throughput of the futex hash table",
+	  bench_futex_hash },
+	{ "wake",
+	  "Cost of waking the waiters of a futex",
+	  bench_futex_wake },
+	{ "requeue",
+	  "Cost of requeueing the waiters of a futex",
+	  bench_futex_requeue },
+	{ "lock-pi",
+	  "Throughput of a contended PI futex",
+	  bench_futex_lock_pi },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite epoll_suites[] = {
+	{ "wait",
+	  "Event throughput of epoll_wait() over many fds and threads",
+	  bench_epoll_wait },
+	{ "ctl",
+	  "Throughput of epoll_ctl() over many fds and threads",
+	  bench_epoll_ctl },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite numa_suites[] = {
+	{ "mem",
+	  "Memory bandwidth of threads against local and remote nodes",
+	  bench_numa_mem },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -71,6 +128,15 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "futex",
+	  "futex hashing and wakeups",
+	  futex_suites },
+	{ "epoll",
+	  "epoll scalability",
+	  epoll_suites },
+	{ "numa",
+	  "NUMA memory placement",
+	  numa_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },